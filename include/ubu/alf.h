@@ -0,0 +1,90 @@
+#ifndef _ALF_H
+#define _ALF_H
+
+#include "chunkfile.h"
+#include "aof.h"
+
+/**
+ * Acorn Library Format: a chunk file with a directory (LIB_DIRY) of
+ * members, every member an AOF object in its own LIB_DATA chunk.
+ * object libraries also have an external symbol table (OFL_SYMT)
+ */
+
+typedef struct {
+    /** not null terminated; points into the directory */
+    char const * name;
+    size_t name_len;
+    /** index of the LIB_DATA chunk in the chunk file header */
+    uint32_t chunk_index;
+    /** of the member in the library file */
+    uint32_t file_offset;
+    uint32_t size;
+    /** see Alf_unixTime; both 0 if the entry has none */
+    uint32_t time[2];
+} AlfMember;
+
+typedef struct {
+    uint64_t hash;
+    char const * name /** points into the symbol table; NULL if slot is empty */;
+    uint32_t chunk_index;
+} AlfSymEnt;
+
+typedef struct {
+    ChunkFile ch;
+    /** LIB_TIME and OFL_TIME; 0 if missing */
+    uint32_t lib_time[2];
+    uint32_t symt_time[2];
+
+    uint8_t * _diry;
+    size_t _pos;
+    /** lazy; chunk index -> member, name is NULL for chunks that are none */
+    AlfMember * _members;
+
+    /** lazy; OFL_SYMT and the open addressing table over it */
+    uint8_t * _symt;
+    AlfSymEnt * _syms;
+    size_t _syms_cap;
+} Alf;
+
+/** 0 = ok; will not close [file] */
+int Alf_open(Alf* out, FILE* file);
+void Alf_close(Alf* alf);
+
+void Alf_rewind(Alf* alf);
+/** next used directory entry; false at the end of the directory */
+bool Alf_next(Alf* alf, AlfMember* out);
+/**
+ * the member in LIB_DATA chunk [chunk_index]; the directory is indexed on
+ * first use. 0 = ok
+ */
+int Alf_member(Alf* alf, uint32_t chunk_index, AlfMember* out);
+
+/**
+ * opens the AOF object of [m] straight from the library file, nothing is copied;
+ * close with AofObj_close. 0 = ok
+ */
+int Alf_openMember(AofObj* out, Alf const* alf, AlfMember const* m);
+
+/** seconds since 1970 of an ALF time stamp (centiseconds since 1900) */
+int64_t Alf_unixTime(uint32_t const time[2]);
+
+/**
+ * true if the library has an OFL_SYMT that is not older than the library,
+ * i.e. it was not left behind by a tool that only changed the members
+ */
+bool Alf_hasSymtab(Alf const* alf);
+
+/**
+ * calls [fn] for every entry of OFL_SYMT, in the order of the table;
+ * non zero from [fn] stops and is returned
+ */
+int Alf_forEachSym(Alf* alf, int (*fn)(void* ctx, char const* name, uint32_t chunk_index), void* ctx);
+
+/**
+ * finds the member that defines [name] through OFL_SYMT, without opening any member;
+ * the table is hashed on first use
+ * 0 = found
+ */
+int Alf_lookupSymbol(Alf* alf, char const* name, AlfMember* out);
+
+#endif
@@ -117,14 +117,17 @@ static bool AofReloc_B(AofReloc r) {
 }
 
 typedef struct {
-    /** lazy; check header for length */
-    AofReloc* relocs;
+    /** lazy; check header for length. points into the mapping of a mapped ChunkFile, unless it had to be swapped */
+    AofReloc const* relocs;
+    bool _relocs_heap;
 } AofAreaData;
 
 typedef struct {
     AofHeader header;
     AofAreaHeader * areas;
     AofAreaData * area_data;
+    /** file offset of the data of every area, see Aof_areaFileOffset; NULL without OBJ_AREA */
+    uint32_t * area_offsets;
 
     AofSym * syms;
 } Aof;
@@ -133,36 +136,55 @@ void Aof_free(Aof* aof);
 
 int Aof_read(Aof* out, ChunkFile const* ch);
 
-/** 0 = err */
+/**
+ * only the header and the area headers, for tools that do not need the
+ * symbols or the area contents; syms, area_data and area_offsets stay NULL.
+ * 0 = ok; free with Aof_free
+ */
+int Aof_readHeaders(Aof* out, ChunkFile const* ch);
+
+/** constant time, the offsets are computed by Aof_read; 0 = err */
 size_t Aof_areaFileOffset(ChunkFile* cf, Aof* aof, size_t idx);
 
 AofReloc const* Aof_readAreaRelocs(ChunkFile* cf, Aof* aof, size_t area_idx);
 
-#define AOF_SYMTAB_N_BUCK (16)
+/**
+ * the contents of an area, straight from the mapping of a ChunkFile opened with
+ * ChunkFile_openMapped; NULL if the file is not mapped or the area is zero initialized
+ */
+uint8_t const* Aof_areaData(ChunkFile const* cf, Aof const* aof, size_t idx);
 
 typedef struct {
+    uint64_t hash;
     size_t namelen;
+    /** points into the string table; NULL if the slot is empty */
     char const * namep;
     AofSym *p;
 } SymtabEnt;
 
-typedef struct {
-    SymtabEnt * ents;
-    size_t      nents;
-} SymtabBucket;
-
 typedef struct {
     Aof aof;
     ChunkFile ch;
 
-    SymtabBucket buckets[AOF_SYMTAB_N_BUCK];
+    /**
+     * open addressing, every slot in this one allocation; at most 3/4 full.
+     * name -> first symbol with that name
+     */
+    SymtabEnt * syms;
+    size_t syms_len, syms_cap;
 } AofObj;
 
-/** 0 == ok */
+/** [ent.hash] is computed here; a name that is already in the table is kept. 0 == ok */
 int Symtab_add(AofObj* out, SymtabEnt ent);
 
+/** the first symbol called [name]; NULL if there is none */
+AofSym* AofObj_lookupSymbol(AofObj const* obj, char const* name);
+
 void AofObj_close(AofObj* obj);
 
 int AofObj_open(AofObj* out, FILE* file);
 
+/** the object is embedded in [file] at [base], see ChunkFile_openAt; will not close [file] */
+int AofObj_openAt(AofObj* out, FILE* file, uint32_t base);
+
 #endif
@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include "mapfile.h"
 
 #ifndef PACKED
 # define PACKED __attribute__ ((packed))
@@ -23,17 +24,56 @@ typedef struct {
 
 typedef struct {
   char filename[16];
-  size_t fileSize;
+  uint64_t fileSize;
 } ArIterFileHeader;
 
 typedef struct {
   FILE* file;
-  long  _last;
+  int64_t _last;
+  /** "!<thin>\n": members only reference files next to the archive */
+  bool thin;
 } ArIter;
 
+typedef struct {
+  uint64_t hash;
+  char* name /** NULL if slot is empty */;
+  uint64_t offset /** of the member header */;
+  size_t size;
+} ArMemberEnt;
+
+typedef struct {
+  char const* name;
+  uint64_t offset /** of the member header */;
+} ArSym;
+
+typedef struct {
+  ArSym* syms;
+  size_t syms_len;
+  void* _data;
+} ArSymIndex;
+
+typedef struct {
+  uint64_t hash;
+  char const* name /** points into the symbol index; NULL if slot is empty */;
+  uint64_t offset /** of the member header */;
+} ArSymEnt;
+
 typedef struct {
   ArIter _iter;
   void* exFileNames;
+  size_t exFileNamesLen;
+  /** directory that thin archive members are relative to; NULL = current */
+  char* _dir;
+
+  /** open addressing; member name -> first member with that name */
+  ArMemberEnt* _members;
+  size_t _members_len, _members_cap;
+
+  /** open addressing; symbol name -> first member that defines it */
+  ArSymEnt* _syms;
+  size_t _syms_cap;
+  /** owns the names in _syms */
+  ArSymIndex _symIndex;
 } SmartArchive;
 
 int ArIter_open(ArIter* dest, FILE* file /** will not close */);
@@ -47,12 +87,138 @@ void ArIter_noDataAndNext(ArIterFileHeader const* hd, ArIter* i);
 int ArIter_findNext(void** heapOut, size_t* sizeOut, ArIter* i, char const searchNam[16]);
 
 int SmartArchive_open(SmartArchive* dest, FILE* file /** will not close */);
+/**
+ * only needed for thin archives that are not in the current directory:
+ * their member paths are relative to the directory of [archivePath]
+ */
+void SmartArchive_setPath(SmartArchive* archv, char const* archivePath);
 void SmartArchive_close(SmartArchive* archv);
 void SmartArchive_rewind(SmartArchive* archv);
 char * SmartArchive_nextFileNameHeap(SmartArchive* archv);
 int SmartArchive_continueWithData(void** heapOut, size_t* sizeOut, SmartArchive* archv);
 void SmartArchive_continueNoData(SmartArchive* archv);
+
+/** gets one chunk of member data; non zero stops the stream and is returned */
+typedef int (*ArChunkFn)(void* ctx, void const* data, size_t len);
+#define AR_DEFAULT_CHUNK (64 * 1024)
+/**
+ * like SmartArchive_continueWithData, but hands the data to [fn] in chunks of
+ * at most [chunkSize] bytes (0 = AR_DEFAULT_CHUNK), so a member never has
+ * to fit into memory. the archive is at the next member afterwards,
+ * even if [fn] stopped early
+ * 0 = ok
+ */
+int SmartArchive_streamData(SmartArchive* archv, size_t chunkSize, ArChunkFn fn, void* ctx);
+/**
+ * copies up to [len] bytes from the start of the current member's data into
+ * [buf] without moving on, e.g. to look at a file format's magic bytes;
+ * returns how many bytes there were
+ */
+size_t SmartArchive_peekData(SmartArchive* archv, void* buf, size_t len);
 int SmartArchive_findNext(SmartArchive* archv, void** heapOut, size_t* sizeOut, const char * fileName);
+/** positions the archive at the member header at [offset]; see ArSym */
+void SmartArchive_seekMember(SmartArchive* archv, uint64_t offset);
+
+/**
+ * reads every member header once and remembers where each member is,
+ * so that lookups never scan the archive again
+ * 0 = ok
+ */
+int SmartArchive_indexMembers(SmartArchive* archv);
+/**
+ * finds the first member called [name]; indexes the members on first use
+ * 0 = found
+ */
+int SmartArchive_lookupMember(SmartArchive* archv, char const* name, uint64_t* offsetOut, size_t* sizeOut);
+
+/**
+ * reads the symbol index (see SmartArchive_readSymIndex) once into a hash table
+ * 0 = ok; archives without an index give an empty table
+ */
+int SmartArchive_indexSymbols(SmartArchive* archv);
+/**
+ * finds the first member that defines [name], according to the symbol index;
+ * indexes the symbols on first use. the member can then be read with
+ * SmartArchive_seekMember and SmartArchive_continueWithData
+ * 0 = found
+ */
+int SmartArchive_lookupSymbol(SmartArchive* archv, char const* name, uint64_t* offsetOut);
+
+/**
+ * hidden member with the content hash of every member, written by ar rcH;
+ * lets ar leave an archive alone if none of its inputs changed.
+ * only hidden from this library: GNU ar and nm list it like any other member
+ */
+#define AR_MANIFEST_NAME "__.UBUHASH"
+
+/** symbol index, extended file name table, manifest, ...; not an actual file */
+bool Ar_isMetaMember(char const* name /** from SmartArchive_nextFileNameHeap */);
+
+/**
+ * reads the GNU / SysV ("/", "/SYM64/") or BSD ("__.SYMDEF") symbol index
+ * without touching any other member;
+ * syms_len is 0 if the archive does not have one
+ * 0 = ok
+ */
+int SmartArchive_readSymIndex(ArSymIndex* dest, SmartArchive* archv);
+void ArSymIndex_free(ArSymIndex* idx);
+
+
+/**
+ * member of a MappedArchive; everything points into the mapping.
+ * members of thin archives are mapped separately, until the next call to MappedArchive_next
+ */
+typedef struct {
+  char const* name /** not null terminated */;
+  size_t nameLen;
+  uint8_t const* data /** NULL if a thin archive member could not be opened */;
+  size_t size;
+  uint64_t offset /** of the member header */;
+} ArMemberView;
+
+typedef struct {
+  MappedFile map;
+  char const* exFileNames;
+  size_t exFileNamesLen;
+  size_t _pos;
+  bool thin;
+  char* _dir;
+  MappedFile _member /** of thin archives */;
+  bool _memberOpen;
+} MappedArchive;
+
+/**
+ * copies the name of [m] into [*buf] and null terminates it;
+ * [*buf] is only reallocated if it is too small, so it can be reused
+ * 0 = ok
+ */
+int ArMemberView_nameStr(ArMemberView const* m, char** buf, size_t* cap);
+
+/** 0 = ok */
+int MappedArchive_open(MappedArchive* dest, FILE* file /** will not close */);
+/** see SmartArchive_setPath */
+void MappedArchive_setPath(MappedArchive* archv, char const* archivePath);
+void MappedArchive_close(MappedArchive* archv);
+void MappedArchive_rewind(MappedArchive* archv);
+/** the next call to MappedArchive_next gives the member whose header is at [offset] */
+void MappedArchive_seekMember(MappedArchive* archv, uint64_t offset);
+/**
+ * skips the symbol index and name table members (see Ar_isMetaMember);
+ * false at the end of the archive or if the archive is truncated
+ */
+bool MappedArchive_next(MappedArchive* archv, ArMemberView* out);
+
+/**
+ * true if the archive starts with a sorted BSD index ("__.SYMDEF SORTED",
+ * little endian, as written by ar rcsB)
+ */
+bool MappedArchive_hasSortedIndex(MappedArchive const* archv);
+/**
+ * binary search in the sorted index, straight from the mapping:
+ * nothing is parsed or allocated, only the compared names are touched
+ * 0 = found; [offsetOut] is the header of the first member that defines [name]
+ */
+int MappedArchive_lookupSortedSymbol(MappedArchive const* archv, char const* name, uint64_t* offsetOut);
 
 #endif
 
@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include "utils.h"
+#include "mapfile.h"
 
 #ifndef PACKED
 # define PACKED __attribute__ ((packed))
@@ -41,9 +42,19 @@ typedef struct
         ChunkFile_EntHeader * obj_identification;
         ChunkFile_EntHeader * obj_symtab;
         ChunkFile_EntHeader * obj_strtab;
+
+        // ALF libraries; see alf.h
+        ChunkFile_EntHeader * lib_diry;
+        ChunkFile_EntHeader * lib_time;
+        ChunkFile_EntHeader * ofl_symt;
+        ChunkFile_EntHeader * ofl_time;
     } headers;
 
     char * lazy_strtab;
+
+    /** see ChunkFile_openMapped; the chunks are read straight from [map] */
+    bool mapped;
+    MappedFile map;
 } ChunkFile;
 
 void ChunkFile_close(ChunkFile* file);
@@ -53,6 +64,23 @@ ChunkFile_EntHeader * ChunkFile_findHeader(ChunkFile const* file, char const * n
 /** 0 = ok; ownership of fp is NOT taken; fp is rewinded() ! */
 int ChunkFile_open(ChunkFile* out, FILE* fp);
 
+/**
+ * opens a chunk file that is embedded in [fp] at [base], like the members of an ALF library;
+ * the file_offset of every chunk is made relative to the start of [fp], so nothing is copied
+ * 0 = ok; ownership of fp is NOT taken
+ */
+int ChunkFile_openAt(ChunkFile* out, FILE* fp, uint32_t base);
+
+/**
+ * like ChunkFile_open, but also maps the whole file; every chunk must lie inside of it.
+ * ChunkFile_getStr then points into the mapping and nothing is copied
+ * 0 = ok; ownership of fp is NOT taken, but it has to stay open until ChunkFile_close
+ */
+int ChunkFile_openMapped(ChunkFile* out, FILE* fp);
+
+/** the data of [hd] in the mapping; NULL if the file is not mapped */
+void const* ChunkFile_chunkData(ChunkFile const* cf, ChunkFile_EntHeader const* hd);
+
 char * ChunkFile_readChunk(ChunkFile * cf, ChunkFile_EntHeader * hd);
 
 char * ChunkFile_readIdentHeap(ChunkFile * cf);
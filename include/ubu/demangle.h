@@ -0,0 +1,92 @@
+#ifndef _DEMANGLE_H
+#define _DEMANGLE_H
+
+// Itanium C++ ABI demangler
+// https://itanium-cxx-abi.github.io/cxx-abi/abi.html#mangling
+//
+// Not supported (the name is reported as not demangleable):
+//  - expressions in template arguments and decltype()
+//  - vendor qualifiers (U <name>), e.g. address spaces
+//  - transaction_safe function types (Dx)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct DemArenaBlock DemArenaBlock;
+
+typedef struct {
+  DemArenaBlock * head;
+  size_t size;
+} DemArena;
+
+typedef struct {
+  char const * str;
+  size_t len;
+} DemStr;
+
+/** a demangled type; declarators ("*", "&", "A::*") go between pre and post */
+typedef struct DemType DemType;
+struct DemType {
+  DemStr pre;
+  DemStr post;
+  /** function or array type that has no declarator yet */
+  bool needs_paren;
+  /** 0, '&' or 'O' (rvalue) if the outermost declarator is a reference */
+  char ref;
+  /** template argument pack; pre is the comma separated list */
+  DemType const * elems;
+  size_t nelems;
+  bool is_pack;
+  /** T_ index + 1 of a substitution that is a bare template parameter */
+  size_t tparam;
+};
+
+typedef struct {
+  uint64_t hash;
+  char const * mangled /** NULL if slot is empty */;
+  size_t mangled_len;
+  char const * demangled /** NULL if the name could not be demangled */;
+} DemNameEnt;
+
+/** a demangled nested-name type together with the substitutions it adds */
+typedef struct {
+  uint64_t hash /** of the first DEM_FRAG_KEY bytes */;
+  DemStr span;
+  DemType result;
+  DemType * subs;
+  size_t nsubs;
+} DemFrag;
+
+typedef struct {
+  /** cache entries; flushed when it grows too large */
+  DemArena arena;
+  /** intermediate strings of the name that is being demangled */
+  DemArena scratch;
+
+  DemType * subs;
+  size_t subs_len, subs_cap;
+  DemType * tparams;
+  size_t tparams_len, tparams_cap;
+  DemType * args;
+  size_t args_len, args_cap;
+
+  /** open addressing; mangled name -> demangled name */
+  DemNameEnt * names;
+  size_t names_len, names_cap;
+
+  /** open addressing; mangled nested-name types seen in earlier names */
+  DemFrag ** frags;
+  size_t frags_len, frags_cap;
+} Demangler;
+
+void Demangler_init(Demangler* d);
+void Demangler_free(Demangler* d);
+
+/**
+ * NULL if [mangled] is not a mangled C++ name (or uses unsupported features).
+ * The result is owned by the demangler and valid until the next call.
+ */
+char const* Demangler_demangle(Demangler* d, char const* mangled);
+
+#endif
@@ -420,6 +420,8 @@ int Elf_decodeSectionHeader(Elf64_SectionHeader* dest, size_t id, Elf_Header con
 int Elf_readSection(void** heapDest, size_t* sizeDest, Elf_Header const* elf, Elf64_SectionHeader const* section, FILE* file, void (*err)(const char *));
 int Elf_getStrTable(char** heapDest, size_t* sizeDest, size_t id, Elf_Header const* elf, FILE* file, void (*err)(const char *));
 int Elf_getSymTable(Elf64_Sym** heapDest, size_t* sizeDest, Elf_Header const* elf, Elf64_SectionHeader const* section, FILE* file, void (*err)(const char *));
+/** like Elf_getSymTable, but skips the first [first] entries without reading them; *heapDest is NULL if none are left */
+int Elf_getSymTableFrom(Elf64_Sym** heapDest, size_t* sizeDest, size_t first, Elf_Header const* elf, Elf64_SectionHeader const* section, FILE* file, void (*err)(const char *));
 
 typedef struct {
   FILE* file;
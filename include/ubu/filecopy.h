@@ -0,0 +1,28 @@
+#ifndef _FILECOPY_H
+#define _FILECOPY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * copies [len] bytes of [in] starting at [inOff] to [out] at [outOff].
+ * uses copy_file_range or sendfile where available so the data does not
+ * go through user space, otherwise a fixed size buffer.
+ * [in] and [out] may be the same file if [outOff] <= [inOff].
+ * the FILE positions of both files are unspecified afterwards
+ * 0 = ok
+ */
+int File_copyRange(FILE* out, uint64_t outOff, FILE* in, uint64_t inOff, uint64_t len);
+
+/**
+ * same as File_copyRange, but [src] is the contents of [in] (see MappedFile)
+ * and the fallback writes from there; [in] is never read through its FILE,
+ * so several threads can copy out of the same [in] at once
+ * 0 = ok
+ */
+int File_copyRangeMapped(FILE* out, uint64_t outOff, FILE* in, void const* src, uint64_t inOff, uint64_t len);
+
+/** sets the size of [out] so the file system can allocate it up front; 0 = ok */
+int File_presize(FILE* out, uint64_t size);
+
+#endif
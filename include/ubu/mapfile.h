@@ -0,0 +1,24 @@
+#ifndef _MAPFILE_H
+#define _MAPFILE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/** read only view of a whole file */
+typedef struct {
+  void const * data;
+  size_t size;
+  /** false if the file had to be read into a heap buffer instead */
+  bool _mapped;
+} MappedFile;
+
+/**
+ * maps [file] (from its current fd, the FILE position does not matter);
+ * falls back to reading the file into memory if it can not be mapped
+ * 0 = ok
+ */
+int MappedFile_open(MappedFile* dest, FILE* file /** will not close */);
+void MappedFile_close(MappedFile* m);
+
+#endif
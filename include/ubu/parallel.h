@@ -0,0 +1,18 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <stddef.h>
+
+/**
+ * calls [fn]([ctx], i) once for every i in [0, count), spread over up to
+ * [threads] threads (0 = one per cpu). the calling thread takes part and
+ * the function only returns once every call is done.
+ * the order of the calls is unspecified, so [fn] should write its result
+ * to a slot indexed by i
+ */
+void Parallel_for(size_t count, unsigned threads, void (*fn)(void* ctx, size_t i), void* ctx);
+
+/** number of online cpus, at least 1 */
+unsigned Parallel_numCpus(void);
+
+#endif
@@ -115,22 +115,6 @@ typedef struct {
   CoffSectionCharacteristics characteristics;
 } PACKED PeSection;
 
-typedef struct {
-  char name[8];
-  uint32_t virtualSize;
-  uint32_t virtualAddress;
-  uint32_t dataUz;
-  uint32_t fileDataOffset;
-  uint32_t fileRelocsOffset;
-  uint32_t fileLinenumsOffset;
-  uint32_t numRelocs;
-  uint32_t numLinenums;
-  CoffSectionCharacteristics characteristics;
-  char _pad[4];
-} PACKED CoffSection;
-
-void ToPeSection(PeSection* dst, CoffSection const* src);
-
 typedef struct {
   CoffHeader header;
   char* heapStrTab;
@@ -140,25 +124,61 @@ typedef struct {
 } OpPe;
 
 static void* OpPe_getSectionPtr(OpPe const* pe, size_t idx) {
-  return pe->isCoff
-      ? (void*) &((CoffSection*) pe->sections)[idx]
-      : (void*) &((PeSection*) pe->sections)[idx]
-      ;
+  return &((PeSection*) pe->sections)[idx];
 }
 
 #define OpPe_sectionMem(pe, sptr, wantty, member) \
-    (pe->isCoff \
-    ? (wantty) ((CoffSection*) sptr)->member \
-    : (wantty) ((PeSection*) sptr)->member)
+    ((void) (pe), (wantty) ((PeSection*) sptr)->member)
 
 static void OpPe_getPeSection(PeSection* dest, OpPe const* pe, size_t idx) {
-  if ( pe->isCoff ) {
-    ToPeSection(dest, &((CoffSection*) pe->sections)[idx]);
-  } else {
-    *dest = ((PeSection*) pe->sections)[idx];
-  }
+  *dest = ((PeSection*) pe->sections)[idx];
 }
 
+/**
+ * header of a short import member of an import library, followed by the
+ * null terminated symbol and dll names; no sections or symbol table
+ */
+typedef struct {
+  uint16_t sig1 /** IMAGE_FILE_MACHINE_UNKNOWN (0) */;
+  uint16_t sig2 /** 0xFFFF */;
+  uint16_t version;
+  uint16_t machine;
+  uint32_t timeDateStamp;
+  uint32_t sizeOfData /** of the names after the header */;
+  uint16_t ordinalOrHint;
+  uint16_t typeInfo /** type: 2 bits, then name type: 3 bits */;
+} PACKED CoffImportHeader;
+
+typedef enum {
+  IMPORT_OBJECT_CODE = 0,
+  IMPORT_OBJECT_DATA = 1,
+  IMPORT_OBJECT_CONST = 2,
+} CoffImportType;
+
+typedef enum {
+  IMPORT_OBJECT_ORDINAL = 0, // imported by ordinalOrHint
+  IMPORT_OBJECT_NAME = 1, // imported by the symbol name, ordinalOrHint is only a hint
+  IMPORT_OBJECT_NAME_NO_PREFIX = 2, // same, without a leading ?, @ or _
+  IMPORT_OBJECT_NAME_UNDECORATE = 3, // same, also without anything after a @
+  IMPORT_OBJECT_NAME_EXPORTAS = 4, // a third name follows the dll name
+} CoffImportNameType;
+
+typedef struct {
+  CoffImportType type;
+  CoffImportNameType nameType;
+  uint16_t machine;
+  uint16_t ordinalOrHint;
+  /** both point into the member */
+  char const* symbol;
+  char const* dll;
+} CoffImport;
+
+/**
+ * parses a short import member straight from its bytes, nothing is copied
+ * 0 = ok; non zero if [data] is not one
+ */
+int CoffImport_parse(CoffImport* out, void const* data, size_t size);
+
 const char* CoffSym_name(CoffSym const* sym, OpPe* pe);
 void OpPe_rewindToSyms(OpPe* pe);
 void OpPe_nextSym(CoffSym* out, OpPe* pe);
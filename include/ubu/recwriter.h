@@ -0,0 +1,48 @@
+#ifndef _RECWRITER_H
+#define _RECWRITER_H
+
+// Streaming writer for the machine readable output of nm and size.
+// See docs/record-format.md for the JSON and binary layouts.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum {
+  RecFormat_JSON,
+  RecFormat_BINARY,
+} RecFormat;
+
+#define REC_MAGIC "ubu-rec"
+#define REC_VERSION 1
+
+typedef enum {
+  RecType_END  = 0,
+  RecType_FILE = 1,
+  RecType_SYM  = 2,
+  RecType_SIZE = 3,
+} RecType;
+
+#define RecSymFlag_HAS_VALUE 1
+
+typedef struct {
+  FILE* out;
+  RecFormat format;
+  /** records written into the current JSON array */
+  size_t _count;
+  bool _inFile;
+  bool _hasSyms;
+} RecWriter;
+
+/** [tool] is "nm" or "size" */
+void RecWriter_begin(RecWriter* w, FILE* out, RecFormat format, char const* tool);
+/** [member] is NULL unless the file is an archive member */
+void RecWriter_file(RecWriter* w, char const* path, char const* member);
+void RecWriter_sym(RecWriter* w, char const* name, char type, uint64_t value, bool hasValue);
+void RecWriter_size(RecWriter* w, uint64_t text, uint64_t data, uint64_t bss);
+void RecWriter_end(RecWriter* w);
+
+/** "json" or "binary"; 0 = ok */
+int RecFormat_parse(RecFormat* dest, char const* str);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef _UTILS_H
 #define _UTILS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -22,4 +23,44 @@ uint64_t hash(const unsigned char *data, int len);
 
 int strieq(char const *a, char const *b);
 
+/**
+ * open addressing hash tables with linear probing: a power of 2 number of
+ * fixed size slots that all start with the uint64_t hash of their key;
+ * zeroed slots are empty
+ */
+typedef struct {
+  size_t slot_size;
+  /** false for an empty slot */
+  bool (*used)(void const *slot);
+  /** the used [slot] holds [key]; only asked if the hashes are equal */
+  bool (*holds)(void const *slot, void const *key);
+} HashSlots;
+
+/** the slot that holds [key], or the empty one where it goes */
+void *HashSlots_find(HashSlots const *t, void *slots, size_t cap,
+                     void const *key, uint64_t h);
+
+/**
+ * makes room for [count] entries in [slots] (NULL for a new table) of [*cap]
+ * slots, which are kept at most 3/4 full; growing moves the slots over to a
+ * new table by their stored hashes, no key is hashed again.
+ * the table to use from now on; NULL if out of memory, [slots] is kept then
+ */
+void *HashSlots_reserve(HashSlots const *t, void *slots, size_t *cap,
+                        size_t count);
+
+typedef enum {
+  ObjFmt_UNKNOWN,
+  ObjFmt_ELF,
+  ObjFmt_PE /** also plain COFF */,
+  ObjFmt_AOF,
+  ObjFmt_COFF_IMPORT /** short import member of an import library */,
+} ObjFmt;
+
+/**
+ * guesses the format of an object file from its first [len] (up to 4) bytes,
+ * so a file that is none of them does not have to be read any further
+ */
+ObjFmt ObjFmt_detect(unsigned char const *magic, size_t len);
+
 #endif
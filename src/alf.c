@@ -0,0 +1,260 @@
+#include "ubu/alf.h"
+#include "ubu/utils.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// LIB_DIRY and OFL_SYMT entries: chunk index, entry length, data length, data
+#define ENTRY_HEAD 12
+
+static uint32_t readWord(Alf const *alf, uint8_t const *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  if (alf->ch.read_swapped)
+    endianess_swap(v);
+  return v;
+}
+
+static void readTime(Alf *alf, ChunkFile_EntHeader *hd, uint32_t out[2]) {
+  out[0] = out[1] = 0;
+  if (!hd || hd->size < 8)
+    return;
+  uint8_t buf[8];
+  fseek(alf->ch.file, hd->file_offset, SEEK_SET);
+  if (fread(buf, 1, 8, alf->ch.file) != 8)
+    return;
+  out[0] = readWord(alf, buf);
+  out[1] = readWord(alf, buf + 4);
+}
+
+/** centiseconds since 1900 */
+static uint64_t timeCs(uint32_t const time[2]) {
+  // the low half of the second word is not part of the count
+  return ((uint64_t)time[0] << 16) | (time[1] >> 16);
+}
+
+int64_t Alf_unixTime(uint32_t const time[2]) {
+  // 1900 to 1970, 17 leap years
+  return (int64_t)(timeCs(time) / 100) - 2208988800;
+}
+
+/**
+ * the entry at [*pos] of a LIB_DIRY or OFL_SYMT chunk; [*pos] is moved to the next one
+ * 0 = ok, 1 = end or malformed
+ */
+static int nextEntry(Alf const *alf, uint8_t const *tab, size_t size,
+                     size_t *pos, uint32_t *chunkIndex, uint8_t const **data,
+                     uint32_t *dataLen) {
+  if (*pos > size || size - *pos < ENTRY_HEAD)
+    return 1;
+  uint8_t const *p = tab + *pos;
+  uint32_t entryLen = readWord(alf, p + 4);
+  uint32_t len = readWord(alf, p + 8);
+  if (entryLen < ENTRY_HEAD || entryLen > size - *pos ||
+      len > entryLen - ENTRY_HEAD)
+    return 1;
+
+  *chunkIndex = readWord(alf, p);
+  *data = p + ENTRY_HEAD;
+  *dataLen = len;
+  *pos += entryLen;
+  return 0;
+}
+
+int Alf_open(Alf *out, FILE *file) {
+  memset(out, 0, sizeof(Alf));
+  if (ChunkFile_open(&out->ch, file))
+    return 1;
+
+  ChunkFile_EntHeader *diry = out->ch.headers.lib_diry;
+  if (!diry || !diry->file_offset ||
+      !(out->_diry = (uint8_t *)ChunkFile_readChunk(&out->ch, diry))) {
+    ChunkFile_close(&out->ch);
+    return 1;
+  }
+
+  readTime(out, out->ch.headers.lib_time, out->lib_time);
+  readTime(out, out->ch.headers.ofl_time, out->symt_time);
+  return 0;
+}
+
+void Alf_close(Alf *alf) {
+  free(alf->_diry);
+  free(alf->_members);
+  free(alf->_symt);
+  free(alf->_syms);
+  ChunkFile_close(&alf->ch);
+}
+
+void Alf_rewind(Alf *alf) { alf->_pos = 0; }
+
+static bool isDataChunk(Alf const *alf, uint32_t chunkIndex) {
+  if (chunkIndex >= alf->ch.num_chunks)
+    return false;
+  ChunkFile_EntHeader const *hd = &alf->ch.chunks[chunkIndex];
+  return hd->file_offset && !memcmp(hd->id, "LIB_DATA", 8);
+}
+
+bool Alf_next(Alf *alf, AlfMember *out) {
+  size_t size = alf->ch.headers.lib_diry->size;
+  uint32_t chunkIndex, len;
+  uint8_t const *data;
+  while (!nextEntry(alf, alf->_diry, size, &alf->_pos, &chunkIndex, &data,
+                    &len)) {
+    // 0 = unused entry
+    if (!chunkIndex || !isDataChunk(alf, chunkIndex))
+      continue;
+
+    ChunkFile_EntHeader const *hd = &alf->ch.chunks[chunkIndex];
+    out->name = (char const *)data;
+    out->name_len = strnlen((char const *)data, len);
+    out->chunk_index = chunkIndex;
+    out->file_offset = hd->file_offset;
+    out->size = hd->size;
+
+    // the time stamp is the last 2 words of the data, after the padded name
+    out->time[0] = out->time[1] = 0;
+    if (len >= 8 && len - 8 > out->name_len) {
+      out->time[0] = readWord(alf, data + len - 8);
+      out->time[1] = readWord(alf, data + len - 4);
+    }
+    return true;
+  }
+  return false;
+}
+
+static int indexMembers(Alf *alf) {
+  if (alf->_members)
+    return 0;
+  alf->_members =
+      calloc(alf->ch.num_chunks ? alf->ch.num_chunks : 1, sizeof(AlfMember));
+  if (!alf->_members)
+    return 1;
+
+  // one pass over the directory, without disturbing an iteration
+  size_t pos = alf->_pos;
+  Alf_rewind(alf);
+  AlfMember m;
+  while (Alf_next(alf, &m))
+    if (!alf->_members[m.chunk_index].name)
+      alf->_members[m.chunk_index] = m;
+  alf->_pos = pos;
+  return 0;
+}
+
+int Alf_member(Alf *alf, uint32_t chunkIndex, AlfMember *out) {
+  if (indexMembers(alf) || chunkIndex >= alf->ch.num_chunks ||
+      !alf->_members[chunkIndex].name)
+    return 1;
+  *out = alf->_members[chunkIndex];
+  return 0;
+}
+
+int Alf_openMember(AofObj *out, Alf const *alf, AlfMember const *m) {
+  return AofObj_openAt(out, alf->ch.file, m->file_offset);
+}
+
+bool Alf_hasSymtab(Alf const *alf) {
+  ChunkFile_EntHeader const *hd = alf->ch.headers.ofl_symt;
+  if (!hd || !hd->file_offset)
+    return false;
+  // a library without time stamps can not tell
+  if (!alf->ch.headers.lib_time || !alf->ch.headers.ofl_time)
+    return true;
+  return timeCs(alf->symt_time) >= timeCs(alf->lib_time);
+}
+
+static int readSymt(Alf *alf) {
+  if (alf->_symt)
+    return 0;
+  if (!Alf_hasSymtab(alf))
+    return 1;
+  alf->_symt =
+      (uint8_t *)ChunkFile_readChunk(&alf->ch, alf->ch.headers.ofl_symt);
+  return !alf->_symt;
+}
+
+int Alf_forEachSym(Alf *alf,
+                   int (*fn)(void *ctx, char const *name, uint32_t chunkIndex),
+                   void *ctx) {
+  if (readSymt(alf))
+    return 1;
+
+  size_t size = alf->ch.headers.ofl_symt->size;
+  size_t pos = 0;
+  uint32_t chunkIndex, len;
+  uint8_t const *data;
+  while (!nextEntry(alf, alf->_symt, size, &pos, &chunkIndex, &data, &len)) {
+    // names that are not terminated inside the entry are skipped
+    if (!chunkIndex || strnlen((char const *)data, len) == len)
+      continue;
+    int res = fn(ctx, (char const *)data, chunkIndex);
+    if (res)
+      return res;
+  }
+  return 0;
+}
+
+static bool symUsed(void const *slot) { return ((AlfSymEnt const *)slot)->name; }
+
+static bool symHolds(void const *slot, void const *name) {
+  return !strcmp(((AlfSymEnt const *)slot)->name, name);
+}
+
+static HashSlots const symSlots = {sizeof(AlfSymEnt), symUsed, symHolds};
+
+static AlfSymEnt *findSymSlot(AlfSymEnt *ents, size_t cap, char const *name,
+                              uint64_t h) {
+  return HashSlots_find(&symSlots, ents, cap, name, h);
+}
+
+static uint64_t symHash(char const *name) {
+  return hash((unsigned char const *)name, (int)strlen(name));
+}
+
+static int countSym(void *ctx, char const *name, uint32_t chunkIndex) {
+  (void)name;
+  (void)chunkIndex;
+  (*(size_t *)ctx)++;
+  return 0;
+}
+
+static int addSym(void *ctx, char const *name, uint32_t chunkIndex) {
+  Alf *alf = ctx;
+  uint64_t h = symHash(name);
+  AlfSymEnt *e = findSymSlot(alf->_syms, alf->_syms_cap, name, h);
+  if (e->name)
+    return 0; // the first definition wins, as for a linker
+  e->hash = h;
+  e->name = name;
+  e->chunk_index = chunkIndex;
+  return 0;
+}
+
+static int indexSyms(Alf *alf) {
+  if (alf->_syms)
+    return 0;
+
+  size_t count = 0;
+  if (Alf_forEachSym(alf, countSym, &count))
+    return 1;
+
+  alf->_syms = HashSlots_reserve(&symSlots, NULL, &alf->_syms_cap, count);
+  if (!alf->_syms)
+    return 1;
+
+  // the names stay in the symbol table chunk, they are not copied
+  return Alf_forEachSym(alf, addSym, alf);
+}
+
+int Alf_lookupSymbol(Alf *alf, char const *name, AlfMember *out) {
+  if (indexSyms(alf))
+    return 1;
+  AlfSymEnt *e =
+      findSymSlot(alf->_syms, alf->_syms_cap, name, symHash(name));
+  if (!e->name)
+    return 1;
+  return out ? Alf_member(alf, e->chunk_index, out) : 0;
+}
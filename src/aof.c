@@ -70,17 +70,19 @@ char *AofSymAttr_str(AofSymAttr a) {
 }
 
 void Aof_free(Aof *aof) {
-  for (size_t i = 0; i < aof->header.num_areas; i++) {
+  for (size_t i = 0; aof->area_data && i < aof->header.num_areas; i++) {
     AofAreaData *data = &aof->area_data[i];
-    if (data->relocs)
-      free(data->relocs);
+    if (data->_relocs_heap)
+      free((void *)data->relocs);
   }
   free(aof->area_data);
+  free(aof->area_offsets);
   free(aof->areas);
   free(aof->syms);
 }
 
-int Aof_read(Aof *out, ChunkFile const *ch) {
+int Aof_readHeaders(Aof *out, ChunkFile const *ch) {
+  memset(out, 0, sizeof(Aof));
   if (!ch->headers.obj_head)
     return 1;
 
@@ -104,6 +106,7 @@ int Aof_read(Aof *out, ChunkFile const *ch) {
   if (fread(out->areas, sizeof(AofAreaHeader), out->header.num_areas,
             ch->file) != out->header.num_areas) {
     free(out->areas);
+    out->areas = NULL;
     return 1;
   }
 
@@ -118,6 +121,41 @@ int Aof_read(Aof *out, ChunkFile const *ch) {
     }
   }
 
+  return 0;
+}
+
+/**
+ * every area is followed by its relocations in OBJ_AREA; zero initialized
+ * areas have no data there. the offsets are summed up once, so that looking
+ * one up does not depend on the number of areas before it
+ * 0 = ok, 1 = the areas do not fit into OBJ_AREA
+ */
+static int layoutAreas(Aof *aof, ChunkFile const *ch) {
+  ChunkFile_EntHeader const *hd = ch->headers.obj_area;
+  if (!hd || !hd->file_offset)
+    return 0;
+
+  aof->area_offsets = malloc(sizeof(uint32_t) * aof->header.num_areas);
+  if (!aof->area_offsets)
+    return 1;
+
+  uint64_t off = 0;
+  for (size_t i = 0; i < aof->header.num_areas; i++) {
+    AofAreaHeader const *h = &aof->areas[i];
+    aof->area_offsets[i] = hd->file_offset + (uint32_t)off;
+    if (!(h->attributes & AofAreaAttrib_ZEROI))
+      off += h->size;
+    off += (uint64_t)h->num_relocs * sizeof(AofReloc);
+    if (off > hd->size)
+      return 1;
+  }
+  return 0;
+}
+
+int Aof_read(Aof *out, ChunkFile const *ch) {
+  if (Aof_readHeaders(out, ch))
+    return 1;
+
   out->syms = malloc(sizeof(AofSym) * out->header.num_syms);
   if (!out->syms) {
     free(out->areas);
@@ -154,22 +192,20 @@ int Aof_read(Aof *out, ChunkFile const *ch) {
     return 1;
   }
 
+  if (layoutAreas(out, ch)) {
+    Aof_free(out);
+    return 1;
+  }
+
   return 0;
 }
 
 /** 0 = err */
 size_t Aof_areaFileOffset(ChunkFile *cf, Aof *aof, size_t idx) {
-  if (cf->headers.obj_area == NULL)
+  (void)cf;
+  if (!aof->area_offsets || idx >= aof->header.num_areas)
     return 0;
-
-  size_t off = cf->headers.obj_area->file_offset;
-
-  for (size_t i = 0; i < idx; i++) {
-    off += aof->areas[i].size;
-    off += aof->areas[i].num_relocs * sizeof(AofReloc);
-  }
-
-  return off;
+  return aof->area_offsets[idx];
 }
 
 AofReloc const *Aof_readAreaRelocs(ChunkFile *cf, Aof *aof, size_t area_idx) {
@@ -178,19 +214,35 @@ AofReloc const *Aof_readAreaRelocs(ChunkFile *cf, Aof *aof, size_t area_idx) {
 
   AofAreaHeader *ahp = &aof->areas[area_idx];
 
-  AofReloc *relocs = malloc(sizeof(AofReloc) * ahp->num_relocs);
-  if (!relocs)
-    return NULL;
-
   size_t off = Aof_areaFileOffset(cf, aof, area_idx);
   if (off == 0)
     return NULL;
-  fseek(cf->file, off + ahp->size, SEEK_SET);
+  if (!(ahp->attributes & AofAreaAttrib_ZEROI))
+    off += ahp->size;
+
+  // Aof_read made sure that the relocations are inside of OBJ_AREA
+  AofReloc const *mapped =
+      cf->mapped ? (AofReloc const *)((uint8_t const *)cf->map.data + off)
+                 : NULL;
+  if (mapped && !cf->read_swapped) {
+    aof->area_data[area_idx].relocs = mapped;
+    return mapped;
+  }
 
-  if (fread(relocs, sizeof(AofReloc), ahp->num_relocs, cf->file) !=
-      ahp->num_relocs) {
-    free(relocs);
+  AofReloc *relocs = malloc(sizeof(AofReloc) * ahp->num_relocs);
+  if (!relocs)
     return NULL;
+
+  if (mapped) {
+    memcpy(relocs, mapped, sizeof(AofReloc) * ahp->num_relocs);
+  } else {
+    fseek(cf->file, off, SEEK_SET);
+
+    if (fread(relocs, sizeof(AofReloc), ahp->num_relocs, cf->file) !=
+        ahp->num_relocs) {
+      free(relocs);
+      return NULL;
+    }
   }
 
   if (cf->read_swapped) {
@@ -201,60 +253,125 @@ AofReloc const *Aof_readAreaRelocs(ChunkFile *cf, Aof *aof, size_t area_idx) {
   }
 
   aof->area_data[area_idx].relocs = relocs;
+  aof->area_data[area_idx]._relocs_heap = true;
   return relocs;
 }
 
-/** 0 == ok */
-int Symtab_add(AofObj *out, SymtabEnt ent) {
-  size_t buck =
-      hash((unsigned char const *)ent.namep, ent.namelen) % AOF_SYMTAB_N_BUCK;
+uint8_t const *Aof_areaData(ChunkFile const *cf, Aof const *aof,
+                            size_t idx) {
+  if (!cf->mapped || !aof->area_offsets || idx >= aof->header.num_areas ||
+      (aof->areas[idx].attributes & AofAreaAttrib_ZEROI))
+    return NULL;
+  return (uint8_t const *)cf->map.data + aof->area_offsets[idx];
+}
 
-  SymtabEnt *new = realloc(out->buckets[buck].ents,
-                           (out->buckets[buck].nents + 1) * sizeof(SymtabEnt));
-  if (new == NULL)
-    return 1;
+/** names in the string table are compared by length first */
+typedef struct {
+  char const *name;
+  size_t len;
+} SymKey;
 
-  new[out->buckets[buck].nents++] = ent;
+static bool symUsed(void const *slot) {
+  return ((SymtabEnt const *)slot)->namep;
+}
+
+static bool symHolds(void const *slot, void const *key) {
+  SymtabEnt const *e = slot;
+  SymKey const *k = key;
+  return e->namelen == k->len && !memcmp(e->namep, k->name, k->len);
+}
 
-  out->buckets[buck].ents = new;
+static HashSlots const symSlots = {sizeof(SymtabEnt), symUsed, symHolds};
 
+static SymtabEnt *findSymSlot(SymtabEnt *ents, size_t cap, char const *name,
+                              size_t len, uint64_t h) {
+  SymKey key = {name, len};
+  return HashSlots_find(&symSlots, ents, cap, &key, h);
+}
+
+/** makes room for [count] symbols in total; 0 == ok */
+static int symtabReserve(AofObj *obj, size_t count) {
+  SymtabEnt *ents =
+      HashSlots_reserve(&symSlots, obj->syms, &obj->syms_cap, count);
+  if (!ents)
+    return 1;
+  obj->syms = ents;
   return 0;
 }
 
+/** 0 == ok */
+int Symtab_add(AofObj *out, SymtabEnt ent) {
+  if (symtabReserve(out, out->syms_len + 1))
+    return 1;
+
+  ent.hash = hash((unsigned char const *)ent.namep, (int)ent.namelen);
+  SymtabEnt *e =
+      findSymSlot(out->syms, out->syms_cap, ent.namep, ent.namelen, ent.hash);
+  if (e->namep)
+    return 0;
+  *e = ent;
+  out->syms_len++;
+  return 0;
+}
+
+AofSym *AofObj_lookupSymbol(AofObj const *obj, char const *name) {
+  if (!obj->syms)
+    return NULL;
+  size_t len = strlen(name);
+  SymtabEnt *e = findSymSlot(obj->syms, obj->syms_cap, name, len,
+                             hash((unsigned char const *)name, (int)len));
+  return e->namep ? e->p : NULL;
+}
+
 void AofObj_close(AofObj *obj) {
-  for (size_t i = 0; i < AOF_SYMTAB_N_BUCK; i++) {
-    free(obj->buckets[i].ents);
-  }
+  free(obj->syms);
 
   Aof_free(&obj->aof);
   ChunkFile_close(&obj->ch);
 }
 
-/** takes ownership of file */
-int AofObj_open(AofObj *out, FILE *file) {
-  memset(out, 0, sizeof(AofObj));
-
-  if (ChunkFile_open(&out->ch, file) != 0)
-    return 1;
-
+/** everything after the chunk file is open; closes it on error */
+static int openObj(AofObj *out) {
   if (Aof_read(&out->aof, &out->ch) != 0) {
     ChunkFile_close(&out->ch);
     return 1;
   }
 
+  // sized once up front, adding never has to grow the table
+  if (symtabReserve(out, out->aof.header.num_syms)) {
+    AofObj_close(out);
+    return 1;
+  }
+
   for (size_t i = 0; i < out->aof.header.num_syms; i++) {
     AofSym *s = &out->aof.syms[i];
     char const *name = ChunkFile_getStr(&out->ch, s->name);
-    if (name == NULL) {
+    if (name == NULL || Symtab_add(out, (SymtabEnt){
+                                            .namelen = strlen(name),
+                                            .namep = name,
+                                            .p = s,
+                                        })) {
       AofObj_close(out);
       return 1;
     }
-    Symtab_add(out, (SymtabEnt){
-                        .namelen = strlen(name),
-                        .namep = name,
-                        .p = s,
-                    });
   }
 
   return 0;
 }
+
+/** takes ownership of file */
+int AofObj_open(AofObj *out, FILE *file) {
+  memset(out, 0, sizeof(AofObj));
+
+  if (ChunkFile_open(&out->ch, file) != 0)
+    return 1;
+  return openObj(out);
+}
+
+int AofObj_openAt(AofObj *out, FILE *file, uint32_t base) {
+  memset(out, 0, sizeof(AofObj));
+
+  if (ChunkFile_openAt(&out->ch, file, base) != 0)
+    return 1;
+  return openObj(out);
+}
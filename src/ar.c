@@ -1,6 +1,18 @@
 #include "ubu/ar.h"
+#include "ubu/utils.h"
 #include <stdbool.h>
 
+/** header fields are space padded decimal numbers */
+static bool parseDecimal(char const *field, size_t len, uint64_t *out) {
+  if (!len || field[0] < '0' || field[0] > '9')
+    return false;
+  uint64_t v = 0;
+  for (size_t i = 0; i < len && field[i] >= '0' && field[i] <= '9'; i++)
+    v = v * 10 + (uint64_t)(field[i] - '0');
+  *out = v;
+  return true;
+}
+
 int ArIter_open(ArIter *dest, FILE *consumeFile) {
   rewind(consumeFile);
 
@@ -10,44 +22,95 @@ int ArIter_open(ArIter *dest, FILE *consumeFile) {
   if (fread(magic, 1, 8, consumeFile) != 8)
     return 1;
 
-  if (memcmp(magic, "!<arch>\x0A", 8))
+  if (!memcmp(magic, "!<arch>\x0A", 8))
+    dest->thin = false;
+  else if (!memcmp(magic, "!<thin>\x0A", 8))
+    dest->thin = true;
+  else
     return 1;
 
   return 0;
 }
 
+/**
+ * members of thin archives are always named "/<offset>" and have no data
+ * in the archive; only the symbol index and the name table do
+ */
+static bool isThinMember(bool thin, char const filename[16]) {
+  return thin && filename[0] == '/' && filename[1] >= '0' && filename[1] <= '9';
+}
+
+/** directory part of [path] (heap), NULL for the current directory */
+static char *dirOf(char const *path) {
+  char const *slash = strrchr(path, '/');
+  if (!slash)
+    return NULL;
+  size_t len = slash == path ? 1 : (size_t)(slash - path);
+  char *dir = malloc(len + 1);
+  if (dir) {
+    memcpy(dir, path, len);
+    dir[len] = '\0';
+  }
+  return dir;
+}
+
+/** path of a thin archive member (heap); relative names are relative to [dir] */
+static char *thinMemberPath(char const *dir, char const *name, size_t nameLen) {
+  size_t dirLen = dir && name[0] != '/' ? strlen(dir) : 0;
+  char *path = malloc(dirLen + 1 + nameLen + 1);
+  if (!path)
+    return NULL;
+  char *p = path;
+  if (dirLen) {
+    memcpy(p, dir, dirLen);
+    p += dirLen;
+    *p++ = '/';
+  }
+  memcpy(p, name, nameLen);
+  p[nameLen] = '\0';
+  return path;
+}
+
 void ArIter_close(ArIter *i) {}
 
-void ArIter_rewind(ArIter *i) { fseek(i->file, 8, SEEK_SET); }
+void ArIter_rewind(ArIter *i) { fseeko(i->file, 8, SEEK_SET); }
 
 bool ArIter_hasNext(ArIter *i) {
-  long pos = ftell(i->file);
+  off_t pos = ftello(i->file);
   char t;
   bool has = fread(&t, 1, 1, i->file);
-  fseek(i->file, pos, SEEK_SET);
+  fseeko(i->file, pos, SEEK_SET);
   return has;
 }
 
 void ArIter_beginIter(ArIterFileHeader *hdest, ArIter *i) {
-  i->_last = ftell(i->file);
+  i->_last = ftello(i->file);
   Ar_FileHeader temp;
-  fread(&temp, sizeof(Ar_FileHeader), 1, i->file);
-  temp.padding[0] = '\0';
-  char *space = strchr(temp.decimal_file_size, ' ');
-  if (space)
-    *space = '\0';
+  if (fread(&temp, sizeof(Ar_FileHeader), 1, i->file) != 1)
+    memset(&temp, ' ', sizeof(Ar_FileHeader));
   memcpy(hdest->filename, temp.filename, 16);
-  sscanf(temp.decimal_file_size, "%zu", &hdest->fileSize);
+  if (!parseDecimal(temp.decimal_file_size, 10, &hdest->fileSize))
+    hdest->fileSize = 0;
+}
+
+void ArIter_rewindBeginIter(ArIter *i) {
+  fseeko(i->file, (off_t)i->_last, SEEK_SET);
 }
 
-void ArIter_rewindBeginIter(ArIter *i) { fseek(i->file, i->_last, SEEK_SET); }
+// member data is padded to an even offset
 
 void ArIter_readDataAndNext(void *buf, ArIterFileHeader const *hd, ArIter *i) {
+  if (isThinMember(i->thin, hd->filename))
+    return;
   fread(buf, 1, hd->fileSize, i->file);
+  if (hd->fileSize & 1)
+    fgetc(i->file);
 }
 
 void ArIter_noDataAndNext(ArIterFileHeader const *hd, ArIter *i) {
-  fseek(i->file, hd->fileSize, SEEK_CUR);
+  if (isThinMember(i->thin, hd->filename))
+    return;
+  fseeko(i->file, (off_t)(hd->fileSize + (hd->fileSize & 1)), SEEK_CUR);
 }
 
 int ArIter_findNext(void **heapOut, size_t *sizeOut, ArIter *i,
@@ -60,7 +123,7 @@ int ArIter_findNext(void **heapOut, size_t *sizeOut, ArIter *i,
     } else {
       if (sizeOut)
         *sizeOut = fh.fileSize;
-      *heapOut = malloc(fh.fileSize);
+      *heapOut = fh.fileSize <= SIZE_MAX ? malloc(fh.fileSize) : NULL;
       if (*heapOut) {
         ArIter_readDataAndNext(*heapOut, &fh, i);
       } else {
@@ -75,71 +138,100 @@ int ArIter_findNext(void **heapOut, size_t *sizeOut, ArIter *i,
 }
 
 int SmartArchive_open(SmartArchive *dest, FILE *consumeFile) {
+  dest->_dir = NULL;
+  dest->_members = NULL;
+  dest->_members_len = 0;
+  dest->_members_cap = 0;
+  dest->_syms = NULL;
+  dest->_syms_cap = 0;
+  memset(&dest->_symIndex, 0, sizeof(ArSymIndex));
+
   if (ArIter_open(&dest->_iter, consumeFile))
     return 1;
 
-  if (ArIter_findNext(&dest->exFileNames, NULL, &dest->_iter, "//")) {
+  // names in the header are padded with spaces
+  dest->exFileNamesLen = 0;
+  if (ArIter_findNext(&dest->exFileNames, &dest->exFileNamesLen, &dest->_iter,
+                      "//              ")) {
     ArIter_rewind(&dest->_iter);
-    if (ArIter_findNext(&dest->exFileNames, NULL, &dest->_iter, "ARFILENAMES/"))
+    if (ArIter_findNext(&dest->exFileNames, &dest->exFileNamesLen,
+                        &dest->_iter, "ARFILENAMES/    ")) {
       dest->exFileNames = NULL;
+      dest->exFileNamesLen = 0;
+    }
   }
   ArIter_rewind(&dest->_iter);
 
   return 0;
 }
 
+void SmartArchive_setPath(SmartArchive *archv, char const *archivePath) {
+  free(archv->_dir);
+  archv->_dir = dirOf(archivePath);
+}
+
 void SmartArchive_close(SmartArchive *archv) {
   ArIter_close(&archv->_iter);
+  free(archv->_dir);
   if (archv->exFileNames)
     free(archv->exFileNames);
+  for (size_t i = 0; i < archv->_members_cap; i++)
+    free(archv->_members[i].name);
+  free(archv->_members);
+  free(archv->_syms);
+  ArSymIndex_free(&archv->_symIndex);
 }
 
 void SmartArchive_rewind(SmartArchive *archv) { ArIter_rewind(&archv->_iter); }
 
 char *SmartArchive_nextFileNameHeap(SmartArchive *archv) {
-  if (!ArIter_hasNext(&archv->_iter))
-    return NULL;
-
   ArIterFileHeader hd;
-  ArIter_beginIter(&hd, &archv->_iter);
+  bool exName;
+  uint64_t off;
+  for (;;) {
+    if (!ArIter_hasNext(&archv->_iter))
+      return NULL;
+    ArIter_beginIter(&hd, &archv->_iter);
+    exName = archv->exFileNames &&
+             ((hd.filename[0] == ' ') ||
+              (hd.filename[0] == '/' && hd.filename[1] >= '0' &&
+               hd.filename[1] <= '9'));
+    if (!exName)
+      break;
+    // like MappedArchive_next, skip members whose name is not in the table
+    off = 0;
+    parseDecimal(hd.filename + 1, 15, &off);
+    if (off < archv->exFileNamesLen)
+      break;
+    ArIter_noDataAndNext(&hd, &archv->_iter);
+  }
 
   if (hd.filename[0] == '#' && hd.filename[1] == '1' && hd.filename[2] == '/') {
     // BSD 4.4 long file names (the only sane way of doing long file names)
-    char temp[14];
-    temp[13] = '\0';
-    memcpy(temp, hd.filename + 3, 13);
-    size_t uz;
-    sscanf(temp, "%zu", &uz);
+    uint64_t uz;
+    if (!parseDecimal(hd.filename + 3, 13, &uz) || uz > hd.fileSize)
+      uz = 0;
 
     char *actual = malloc(uz + 1);
     if (actual) {
-      fread(actual, 1, uz, archv->_iter.file);
-      fseek(archv->_iter.file, -((long)uz), SEEK_CUR);
+      actual[fread(actual, 1, uz, archv->_iter.file)] = '\0';
     }
 
     ArIter_rewindBeginIter(&archv->_iter);
 
     return actual;
-  } else if (archv->exFileNames &&
-             ((hd.filename[0] == ' ') ||
-              (hd.filename[0] == '/' &&
-               !(hd.filename[1] == '/' || hd.filename[1] == ' ')))) {
-    char temp[16];
-    temp[15] = '\0';
-    memcpy(temp, hd.filename + 1, 15);
-    size_t off;
-    sscanf(temp, "%zu", &off);
+  } else if (exName) {
     const char *old = archv->exFileNames;
     old += off;
-    size_t count = strchr(old, '\n') - old;
+    const char *nl = memchr(old, '\n', archv->exFileNamesLen - (size_t)off);
+    size_t count = nl ? (size_t)(nl - old) : archv->exFileNamesLen - (size_t)off;
     char *new = malloc(count + 1);
     if (new) {
       memcpy(new, old, count);
       new[count] = '\0';
-      char *slash = strchr(new, '/');
-      if (slash) {
-        *slash = '\0';
-      }
+      // names end with a '/', but thin archive members are paths
+      if (count && new[count - 1] == '/')
+        new[count - 1] = '\0';
     }
 
     ArIter_rewindBeginIter(&archv->_iter);
@@ -162,19 +254,155 @@ char *SmartArchive_nextFileNameHeap(SmartArchive *archv) {
   }
 }
 
+/** length of a BSD 4.4 file name that is stored in front of the data */
+static size_t bsdNameLen(ArIterFileHeader const *hd) {
+  if (!(hd->filename[0] == '#' && hd->filename[1] == '1' &&
+        hd->filename[2] == '/'))
+    return 0;
+  uint64_t uz = 0;
+  parseDecimal(hd->filename + 3, 13, &uz);
+  return uz > hd->fileSize ? hd->fileSize : uz;
+}
+
+/**
+ * opens the file that the thin archive member at the current header
+ * references; the archive is positioned at the next member afterwards
+ */
+static FILE *openThinMember(SmartArchive *archv) {
+  // the name is needed, so look at the header again
+  ArIter_rewindBeginIter(&archv->_iter);
+  char *name = SmartArchive_nextFileNameHeap(archv);
+  ArIterFileHeader hd;
+  ArIter_beginIter(&hd, &archv->_iter);
+  if (!name)
+    return NULL;
+  char *path = thinMemberPath(archv->_dir, name, strlen(name));
+  free(name);
+  if (!path)
+    return NULL;
+
+  FILE *f = fopen(path, "rb");
+  free(path);
+  return f;
+}
+
+/** reads the whole file that a thin archive member references */
+static int readThinMember(void **heapOut, size_t *sizeOut,
+                          SmartArchive *archv) {
+  FILE *f = openThinMember(archv);
+  if (!f)
+    return 1;
+
+  MappedFile m;
+  int err = MappedFile_open(&m, f);
+  fclose(f);
+  if (err)
+    return 1;
+
+  *heapOut = malloc(m.size ? m.size : 1);
+  if (*heapOut) {
+    memcpy(*heapOut, m.data, m.size);
+    if (sizeOut)
+      *sizeOut = m.size;
+  }
+  MappedFile_close(&m);
+  return *heapOut == NULL;
+}
+
 int SmartArchive_continueWithData(void **heapOut, size_t *sizeOut,
                                   SmartArchive *archv) {
   ArIterFileHeader hd;
   ArIter_beginIter(&hd, &archv->_iter);
+
+  if (isThinMember(archv->_iter.thin, hd.filename))
+    return readThinMember(heapOut, sizeOut, archv);
+
+  size_t nameLen = bsdNameLen(&hd);
+  uint64_t size = hd.fileSize - nameLen;
+  if (size > SIZE_MAX)
+    return 1;
   if (sizeOut)
-    *sizeOut = hd.fileSize;
-  *heapOut = malloc(hd.fileSize);
+    *sizeOut = size;
+  *heapOut = malloc(size ? size : 1);
   if (!*heapOut)
     return 1;
-  ArIter_readDataAndNext(*heapOut, &hd, &archv->_iter);
+  fseeko(archv->_iter.file, (off_t)nameLen, SEEK_CUR);
+  fread(*heapOut, 1, size, archv->_iter.file);
+  if (hd.fileSize & 1)
+    fgetc(archv->_iter.file);
   return 0;
 }
 
+int SmartArchive_streamData(SmartArchive *archv, size_t chunkSize,
+                            ArChunkFn fn, void *ctx) {
+  if (!chunkSize)
+    chunkSize = AR_DEFAULT_CHUNK;
+
+  ArIterFileHeader hd;
+  ArIter_beginIter(&hd, &archv->_iter);
+
+  FILE *from;
+  uint64_t left;
+  // where the next member starts, in case [fn] stops early
+  off_t next = 0;
+  if (isThinMember(archv->_iter.thin, hd.filename)) {
+    from = openThinMember(archv);
+    if (!from)
+      return 1;
+    left = UINT64_MAX; // until the end of the file
+  } else {
+    size_t nameLen = bsdNameLen(&hd);
+    from = archv->_iter.file;
+    left = hd.fileSize - nameLen;
+    next = ftello(from) + (off_t)(hd.fileSize + (hd.fileSize & 1));
+    fseeko(from, (off_t)nameLen, SEEK_CUR);
+  }
+
+  void *buf = malloc(chunkSize);
+  int ret = buf ? 0 : 1;
+  while (!ret && left) {
+    size_t want = left < chunkSize ? left : chunkSize;
+    size_t got = fread(buf, 1, want, from);
+    if (!got) {
+      // only the end of a thin member's own file is expected
+      ret = from == archv->_iter.file || ferror(from);
+      break;
+    }
+    ret = fn(ctx, buf, got);
+    left -= got;
+  }
+  free(buf);
+
+  if (from != archv->_iter.file)
+    fclose(from);
+  else
+    fseeko(archv->_iter.file, next, SEEK_SET);
+  return ret;
+}
+
+typedef struct {
+  uint8_t *buf;
+  size_t len;
+  size_t got;
+} PeekCtx;
+
+static int peekChunk(void *ctx, void const *data, size_t len) {
+  PeekCtx *p = ctx;
+  size_t n = len < p->len - p->got ? len : p->len - p->got;
+  memcpy(p->buf + p->got, data, n);
+  p->got += n;
+  return p->got == p->len;
+}
+
+size_t SmartArchive_peekData(SmartArchive *archv, void *buf, size_t len) {
+  off_t header = ftello(archv->_iter.file);
+  PeekCtx p = {buf, len, 0};
+  if (len)
+    SmartArchive_streamData(archv, len, peekChunk, &p);
+  fseeko(archv->_iter.file, header, SEEK_SET);
+  return p.got;
+}
+
 void SmartArchive_continueNoData(SmartArchive *archv) {
   ArIterFileHeader hd;
   ArIter_beginIter(&hd, &archv->_iter);
@@ -198,3 +426,550 @@ int SmartArchive_findNext(SmartArchive *archv, void **heapOut, size_t *sizeOut,
 
   return 1;
 }
+
+void SmartArchive_seekMember(SmartArchive *archv, uint64_t offset) {
+  fseeko(archv->_iter.file, (off_t)offset, SEEK_SET);
+}
+
+static uint64_t memberHash(char const *name) {
+  return hash((unsigned char const *)name, (int)strlen(name));
+}
+
+static bool memberUsed(void const *slot) {
+  return ((ArMemberEnt const *)slot)->name;
+}
+
+static bool memberHolds(void const *slot, void const *name) {
+  return !strcmp(((ArMemberEnt const *)slot)->name, name);
+}
+
+static HashSlots const memberSlots = {sizeof(ArMemberEnt), memberUsed,
+                                      memberHolds};
+
+static ArMemberEnt *findMemberSlot(ArMemberEnt *ents, size_t cap,
+                                   char const *name, uint64_t h) {
+  return HashSlots_find(&memberSlots, ents, cap, name, h);
+}
+
+static int reserveMembers(SmartArchive *archv, size_t count) {
+  ArMemberEnt *n = HashSlots_reserve(&memberSlots, archv->_members,
+                                     &archv->_members_cap, count);
+  if (!n)
+    return 1;
+  archv->_members = n;
+  return 0;
+}
+
+int SmartArchive_indexMembers(SmartArchive *archv) {
+  if (archv->_members)
+    return 0;
+  if (reserveMembers(archv, 0))
+    return 1;
+
+  SmartArchive_rewind(archv);
+  char *name;
+  while ((name = SmartArchive_nextFileNameHeap(archv))) {
+    uint64_t offset = (uint64_t)ftello(archv->_iter.file);
+    ArIterFileHeader hd;
+    ArIter_beginIter(&hd, &archv->_iter);
+    ArIter_noDataAndNext(&hd, &archv->_iter);
+
+    if (Ar_isMetaMember(name)) {
+      free(name);
+      continue;
+    }
+
+    if (reserveMembers(archv, archv->_members_len + 1)) {
+      free(name);
+      return 1;
+    }
+
+    uint64_t h = memberHash(name);
+    ArMemberEnt *e = findMemberSlot(archv->_members, archv->_members_cap,
+                                    name, h);
+    if (e->name) {
+      // ar x and ar p use the first member with that name
+      free(name);
+      continue;
+    }
+    e->hash = h;
+    e->name = name;
+    e->offset = offset;
+    e->size = hd.fileSize - bsdNameLen(&hd);
+    archv->_members_len++;
+  }
+  SmartArchive_rewind(archv);
+  return 0;
+}
+
+int SmartArchive_lookupMember(SmartArchive *archv, char const *name,
+                              uint64_t *offsetOut, size_t *sizeOut) {
+  if (SmartArchive_indexMembers(archv))
+    return 1;
+  ArMemberEnt *e = findMemberSlot(archv->_members, archv->_members_cap, name,
+                                  memberHash(name));
+  if (!e->name)
+    return 1;
+  if (offsetOut)
+    *offsetOut = e->offset;
+  if (sizeOut)
+    *sizeOut = e->size;
+  return 0;
+}
+
+static bool isMetaName(char const *name, size_t len) {
+  // "/", "//" and "/SYM64/" have no name once the '/' is cut off
+  return !len || (len == 11 && !memcmp(name, "ARFILENAMES", 11)) ||
+         (len >= 9 && !memcmp(name, "__.SYMDEF", 9)) ||
+         (len == sizeof(AR_MANIFEST_NAME) - 1 &&
+          !memcmp(name, AR_MANIFEST_NAME, len));
+}
+
+bool Ar_isMetaMember(char const *name) {
+  return isMetaName(name, strlen(name));
+}
+
+static uint64_t readBe(uint8_t const *p, size_t bytes) {
+  uint64_t v = 0;
+  for (size_t i = 0; i < bytes; i++)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+static uint32_t readLe32(uint8_t const *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+/** count, offsets, then null terminated names; all big endian */
+static int parseGnuIndex(ArSymIndex *dest, uint8_t const *data, size_t size,
+                         size_t word) {
+  if (size < word)
+    return 1;
+  uint64_t count = readBe(data, word);
+  if (count > (size - word) / word)
+    return 1;
+
+  dest->syms = malloc(sizeof(ArSym) * (count ? count : 1));
+  if (!dest->syms)
+    return 1;
+
+  char const *names = (char const *)data + word + count * word;
+  char const *end = (char const *)data + size;
+  for (uint64_t i = 0; i < count; i++) {
+    char const *nul = memchr(names, '\0', end - names);
+    if (!nul)
+      return 1;
+    ArSym *sym = &dest->syms[dest->syms_len++];
+    sym->name = names;
+    sym->offset = readBe(data + word + i * word, word);
+    names = nul + 1;
+  }
+  return 0;
+}
+
+/** ranlib array size, {strx, off} pairs, string table size, strings */
+static int parseBsdIndex(ArSymIndex *dest, uint8_t const *data, size_t size) {
+  if (size < 4)
+    return 1;
+  uint32_t ranlibSize = readLe32(data);
+  if (ranlibSize % 8 || ranlibSize > size - 4 || size - 4 - ranlibSize < 4)
+    return 1;
+  size_t count = ranlibSize / 8;
+  uint8_t const *ranlibs = data + 4;
+  uint32_t strSize = readLe32(ranlibs + ranlibSize);
+  char const *strs = (char const *)ranlibs + ranlibSize + 4;
+  if (strSize > size - 8 - ranlibSize)
+    return 1;
+
+  dest->syms = malloc(sizeof(ArSym) * (count ? count : 1));
+  if (!dest->syms)
+    return 1;
+
+  for (size_t i = 0; i < count; i++) {
+    uint32_t strx = readLe32(ranlibs + i * 8);
+    if (strx >= strSize || !memchr(strs + strx, '\0', strSize - strx))
+      return 1;
+    ArSym *sym = &dest->syms[dest->syms_len++];
+    sym->name = strs + strx;
+    sym->offset = readLe32(ranlibs + i * 8 + 4);
+  }
+  return 0;
+}
+
+int SmartArchive_readSymIndex(ArSymIndex *dest, SmartArchive *archv) {
+  memset(dest, 0, sizeof(ArSymIndex));
+
+  // the index is always the first member
+  ArIter_rewind(&archv->_iter);
+  if (!ArIter_hasNext(&archv->_iter))
+    return 0;
+
+  ArIterFileHeader hd;
+  ArIter_beginIter(&hd, &archv->_iter);
+  ArIter_rewindBeginIter(&archv->_iter);
+
+  size_t word = 0;
+  if (!memcmp(hd.filename, "/               ", 16)) {
+    word = 4;
+  } else if (!memcmp(hd.filename, "/SYM64/         ", 16)) {
+    word = 8;
+  } else {
+    char *name = SmartArchive_nextFileNameHeap(archv);
+    bool bsd = name && !strncmp(name, "__.SYMDEF", 9);
+    free(name);
+    if (!bsd) {
+      ArIter_rewind(&archv->_iter);
+      return 0;
+    }
+  }
+
+  size_t size;
+  if (SmartArchive_continueWithData(&dest->_data, &size, archv))
+    return 1;
+  ArIter_rewind(&archv->_iter);
+
+  int err = word ? parseGnuIndex(dest, dest->_data, size, word)
+                 : parseBsdIndex(dest, dest->_data, size);
+  if (err) {
+    ArSymIndex_free(dest);
+    return 1;
+  }
+  return 0;
+}
+
+void ArSymIndex_free(ArSymIndex *idx) {
+  free(idx->syms);
+  free(idx->_data);
+  memset(idx, 0, sizeof(ArSymIndex));
+}
+
+static bool symUsed(void const *slot) { return ((ArSymEnt const *)slot)->name; }
+
+static bool symHolds(void const *slot, void const *name) {
+  return !strcmp(((ArSymEnt const *)slot)->name, name);
+}
+
+static HashSlots const symSlots = {sizeof(ArSymEnt), symUsed, symHolds};
+
+static ArSymEnt *findSymSlot(ArSymEnt *ents, size_t cap, char const *name,
+                             uint64_t h) {
+  return HashSlots_find(&symSlots, ents, cap, name, h);
+}
+
+int SmartArchive_indexSymbols(SmartArchive *archv) {
+  if (archv->_syms)
+    return 0;
+
+  ArSymIndex *idx = &archv->_symIndex;
+  if (SmartArchive_readSymIndex(idx, archv))
+    return 1;
+
+  archv->_syms =
+      HashSlots_reserve(&symSlots, NULL, &archv->_syms_cap, idx->syms_len);
+  if (!archv->_syms) {
+    ArSymIndex_free(idx);
+    return 1;
+  }
+
+  // the names stay in the index data, they are not copied
+  for (size_t i = 0; i < idx->syms_len; i++) {
+    ArSym const *sym = &idx->syms[i];
+    uint64_t h = memberHash(sym->name);
+    ArSymEnt *e = findSymSlot(archv->_syms, archv->_syms_cap, sym->name, h);
+    if (e->name)
+      continue; // the first definition wins, as for a linker
+    e->hash = h;
+    e->name = sym->name;
+    e->offset = sym->offset;
+  }
+
+  // only the names are needed from now on
+  free(idx->syms);
+  idx->syms = NULL;
+  idx->syms_len = 0;
+  return 0;
+}
+
+int SmartArchive_lookupSymbol(SmartArchive *archv, char const *name,
+                              uint64_t *offsetOut) {
+  if (SmartArchive_indexSymbols(archv))
+    return 1;
+  ArSymEnt *e =
+      findSymSlot(archv->_syms, archv->_syms_cap, name, memberHash(name));
+  if (!e->name)
+    return 1;
+  if (offsetOut)
+    *offsetOut = e->offset;
+  return 0;
+}
+
+int ArMemberView_nameStr(ArMemberView const *m, char **buf, size_t *cap) {
+  if (m->nameLen + 1 > *cap) {
+    char *n = realloc(*buf, m->nameLen + 1);
+    if (!n)
+      return 1;
+    *buf = n;
+    *cap = m->nameLen + 1;
+  }
+  memcpy(*buf, m->name, m->nameLen);
+  (*buf)[m->nameLen] = '\0';
+  return 0;
+}
+
+
+/**
+ * false if there is no complete member at [pos];
+ * [storedOut] is how much data follows the header in the archive itself
+ */
+static bool mappedMember(MappedArchive const *archv, size_t pos,
+                         Ar_FileHeader const **hdOut, uint64_t *sizeOut,
+                         uint64_t *storedOut) {
+  size_t end = archv->map.size;
+  if (pos > end || end - pos < sizeof(Ar_FileHeader))
+    return false;
+  Ar_FileHeader const *hd =
+      (Ar_FileHeader const *)((uint8_t const *)archv->map.data + pos);
+  uint64_t size;
+  if (!parseDecimal(hd->decimal_file_size, 10, &size))
+    return false;
+  uint64_t stored = isThinMember(archv->thin, hd->filename) ? 0 : size;
+  if (stored > end - pos - sizeof(Ar_FileHeader))
+    return false;
+  *hdOut = hd;
+  *sizeOut = size;
+  *storedOut = stored;
+  return true;
+}
+
+static size_t mappedNext(size_t pos, uint64_t stored) {
+  return pos + sizeof(Ar_FileHeader) + stored + (stored & 1);
+}
+
+static void closeThinMember(MappedArchive *archv) {
+  if (archv->_memberOpen)
+    MappedFile_close(&archv->_member);
+  archv->_memberOpen = false;
+}
+
+/** maps the file that a thin archive member references into [out] */
+static void mapThinMember(MappedArchive *archv, ArMemberView *out) {
+  out->data = NULL;
+  out->size = 0;
+
+  char *path = thinMemberPath(archv->_dir, out->name, out->nameLen);
+  if (!path)
+    return;
+  FILE *f = fopen(path, "rb");
+  free(path);
+  if (!f)
+    return;
+
+  // the mapping stays valid after the file is closed
+  if (!MappedFile_open(&archv->_member, f)) {
+    archv->_memberOpen = true;
+    out->data = archv->_member.data;
+    out->size = archv->_member.size;
+  }
+  fclose(f);
+}
+
+int MappedArchive_open(MappedArchive *dest, FILE *file) {
+  if (MappedFile_open(&dest->map, file))
+    return 1;
+  if (dest->map.size < 8) {
+    MappedFile_close(&dest->map);
+    return 1;
+  }
+  if (!memcmp(dest->map.data, "!<arch>\x0A", 8)) {
+    dest->thin = false;
+  } else if (!memcmp(dest->map.data, "!<thin>\x0A", 8)) {
+    dest->thin = true;
+  } else {
+    MappedFile_close(&dest->map);
+    return 1;
+  }
+
+  dest->exFileNames = NULL;
+  dest->exFileNamesLen = 0;
+  dest->_dir = NULL;
+  dest->_memberOpen = false;
+
+  // the name table comes right after the symbol index (if any)
+  size_t pos = 8;
+  Ar_FileHeader const *hd;
+  uint64_t size, stored;
+  while (mappedMember(dest, pos, &hd, &size, &stored)) {
+    if (!memcmp(hd->filename, "//              ", 16) ||
+        !memcmp(hd->filename, "ARFILENAMES/    ", 16)) {
+      dest->exFileNames = (char const *)(hd + 1);
+      dest->exFileNamesLen = size;
+      break;
+    }
+    if (hd->filename[0] != '/' && memcmp(hd->filename, "__.SYMDEF", 9) &&
+        memcmp(hd->filename, "#1/", 3))
+      break;
+    pos = mappedNext(pos, stored);
+  }
+
+  MappedArchive_rewind(dest);
+  return 0;
+}
+
+void MappedArchive_setPath(MappedArchive *archv, char const *archivePath) {
+  free(archv->_dir);
+  archv->_dir = dirOf(archivePath);
+}
+
+void MappedArchive_close(MappedArchive *archv) {
+  closeThinMember(archv);
+  free(archv->_dir);
+  MappedFile_close(&archv->map);
+}
+
+void MappedArchive_rewind(MappedArchive *archv) { archv->_pos = 8; }
+
+void MappedArchive_seekMember(MappedArchive *archv, uint64_t offset) {
+  // past the end, MappedArchive_next just returns false
+  archv->_pos = offset < archv->map.size ? (size_t)offset : archv->map.size;
+}
+
+bool MappedArchive_next(MappedArchive *archv, ArMemberView *out) {
+  closeThinMember(archv);
+
+  Ar_FileHeader const *hd;
+  uint64_t size, stored;
+  while (mappedMember(archv, archv->_pos, &hd, &size, &stored)) {
+    out->offset = archv->_pos;
+    out->data = (uint8_t const *)(hd + 1);
+    out->size = size;
+    archv->_pos = mappedNext(archv->_pos, stored);
+
+    char const *fn = hd->filename;
+    uint64_t num;
+    if (fn[0] == '#' && fn[1] == '1' && fn[2] == '/' &&
+        parseDecimal(fn + 3, 13, &num) && num <= size) {
+      // BSD 4.4: the name is in front of the data, padded with zeros
+      out->name = (char const *)out->data;
+      out->nameLen = num;
+      while (out->nameLen && !out->name[out->nameLen - 1])
+        out->nameLen--;
+      out->data += num;
+      out->size -= num;
+    } else if (fn[0] == '/' && parseDecimal(fn + 1, 15, &num)) {
+      if (!archv->exFileNames || num >= archv->exFileNamesLen)
+        continue;
+      out->name = archv->exFileNames + num;
+      char const *nl =
+          memchr(out->name, '\n', archv->exFileNamesLen - (size_t)num);
+      out->nameLen =
+          nl ? (size_t)(nl - out->name) : archv->exFileNamesLen - (size_t)num;
+      if (out->nameLen && out->name[out->nameLen - 1] == '/')
+        out->nameLen--;
+    } else {
+      out->name = fn;
+      out->nameLen = 16;
+      char const *slash = memchr(fn, '/', 16);
+      if (slash)
+        out->nameLen = slash - fn;
+      while (out->nameLen && fn[out->nameLen - 1] == ' ')
+        out->nameLen--;
+    }
+
+    if (isMetaName(out->name, out->nameLen))
+      continue;
+
+    if (isThinMember(archv->thin, hd->filename))
+      mapThinMember(archv, out);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * the ranlib array and string table of a "__.SYMDEF SORTED" index;
+ * false if the first member is not one or is damaged
+ */
+static bool sortedIndex(MappedArchive const *archv, uint8_t const **ranlibsOut,
+                        size_t *countOut, char const **strsOut,
+                        uint32_t *strSizeOut) {
+  Ar_FileHeader const *hd;
+  uint64_t size, stored;
+  if (!mappedMember(archv, 8, &hd, &size, &stored))
+    return false;
+
+  uint8_t const *data = (uint8_t const *)(hd + 1);
+  uint64_t num;
+  if (!memcmp(hd->filename, "#1/", 3) && parseDecimal(hd->filename + 3, 13, &num) &&
+      num >= 16 && num <= size) {
+    // BSD 4.4 name, padded with zeros
+    if (memcmp(data, "__.SYMDEF SORTED", 16) ||
+        (num > 16 && data[16] != '\0'))
+      return false;
+    data += num;
+    size -= num;
+  } else if (memcmp(hd->filename, "__.SYMDEF SORTED", 16)) {
+    return false;
+  }
+
+  if (size < 8)
+    return false;
+  uint32_t ranlibSize = readLe32(data);
+  if (ranlibSize % 8 || ranlibSize > size - 8)
+    return false;
+  uint32_t strSize = readLe32(data + 4 + ranlibSize);
+  if (strSize > size - 8 - ranlibSize)
+    return false;
+
+  *ranlibsOut = data + 4;
+  *countOut = ranlibSize / 8;
+  *strsOut = (char const *)data + 8 + ranlibSize;
+  *strSizeOut = strSize;
+  return true;
+}
+
+bool MappedArchive_hasSortedIndex(MappedArchive const *archv) {
+  uint8_t const *ranlibs;
+  size_t count;
+  char const *strs;
+  uint32_t strSize;
+  return sortedIndex(archv, &ranlibs, &count, &strs, &strSize);
+}
+
+/** like strcmp, but a name that runs past the string table is never equal */
+static int compareIndexName(char const *strs, uint32_t strSize, uint32_t strx,
+                            char const *name) {
+  if (strx >= strSize)
+    return 1;
+  size_t max = strSize - strx;
+  size_t len = strlen(name);
+  int c = strncmp(strs + strx, name, len < max ? len + 1 : max);
+  return c ? c : (len < max ? 0 : -1);
+}
+
+int MappedArchive_lookupSortedSymbol(MappedArchive const *archv,
+                                     char const *name, uint64_t *offsetOut) {
+  uint8_t const *ranlibs;
+  size_t count;
+  char const *strs;
+  uint32_t strSize;
+  if (!sortedIndex(archv, &ranlibs, &count, &strs, &strSize))
+    return 1;
+
+  // lower bound, so a name that several members define gives the first one
+  size_t lo = 0, hi = count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (compareIndexName(strs, strSize, readLe32(ranlibs + mid * 8), name) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo == count ||
+      compareIndexName(strs, strSize, readLe32(ranlibs + lo * 8), name))
+    return 1;
+  if (offsetOut)
+    *offsetOut = readLe32(ranlibs + lo * 8 + 4);
+  return 0;
+}
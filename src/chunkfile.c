@@ -13,6 +13,8 @@ static uint32_t CHUNK_FILE_REV_MAGIC = 0xC5C6CBC3;
 void ChunkFile_close(ChunkFile *file) {
   if (file->lazy_strtab)
     free(file->lazy_strtab);
+  if (file->mapped)
+    MappedFile_close(&file->map);
   free(file->chunks);
 }
 
@@ -33,13 +35,19 @@ ChunkFile_EntHeader *ChunkFile_findHeader(ChunkFile const *file,
   return NULL;
 }
 
-/** 0 = ok; ownership of fp is taken; fp is rewinded() ! */
 int ChunkFile_open(ChunkFile *out, FILE *fp) {
+  rewind(fp);
+  return ChunkFile_openAt(out, fp, 0);
+}
+
+int ChunkFile_openAt(ChunkFile *out, FILE *fp, uint32_t base) {
   out->file = fp;
   out->lazy_strtab = NULL;
+  out->mapped = false;
 
   ChunkFile_Header header;
-  rewind(fp);
+  if (fseek(fp, base, SEEK_SET))
+    return 1;
   if (fread(&header, sizeof(ChunkFile_Header), 1, fp) != 1) {
     return 1;
   }
@@ -79,20 +87,69 @@ int ChunkFile_open(ChunkFile *out, FILE *fp) {
     }
   }
 
+  for (size_t i = 0; i < out->num_chunks && base; i++) {
+    ChunkFile_EntHeader *p = &out->chunks[i];
+    if (!p->file_offset)
+      continue;
+    if (p->file_offset > UINT32_MAX - base) {
+      free(out->chunks);
+      return 1;
+    }
+    p->file_offset += base;
+  }
+
   out->headers.obj_head = ChunkFile_findHeader(out, "OBJ_HEAD");
   out->headers.obj_area = ChunkFile_findHeader(out, "OBJ_AREA");
   out->headers.obj_identification = ChunkFile_findHeader(out, "OBJ_IDFN");
   out->headers.obj_symtab = ChunkFile_findHeader(out, "OBJ_SYMT");
   out->headers.obj_strtab = ChunkFile_findHeader(out, "OBJ_STRT");
+  out->headers.lib_diry = ChunkFile_findHeader(out, "LIB_DIRY");
+  out->headers.lib_time = ChunkFile_findHeader(out, "LIB_TIME");
+  out->headers.ofl_symt = ChunkFile_findHeader(out, "OFL_SYMT");
+  out->headers.ofl_time = ChunkFile_findHeader(out, "OFL_TIME");
+
+  return 0;
+}
 
+int ChunkFile_openMapped(ChunkFile *out, FILE *fp) {
+  if (ChunkFile_open(out, fp))
+    return 1;
+  if (MappedFile_open(&out->map, fp)) {
+    ChunkFile_close(out);
+    return 1;
+  }
+  out->mapped = true;
+
+  // checked once, so that the chunks can be used without any bounds checks
+  for (size_t i = 0; i < out->num_chunks; i++) {
+    ChunkFile_EntHeader const *hd = &out->chunks[i];
+    if (hd->file_offset && (hd->file_offset > out->map.size ||
+                            hd->size > out->map.size - hd->file_offset)) {
+      ChunkFile_close(out);
+      return 1;
+    }
+  }
   return 0;
 }
 
+void const *ChunkFile_chunkData(ChunkFile const *cf,
+                                ChunkFile_EntHeader const *hd) {
+  if (!cf->mapped || !hd->file_offset)
+    return NULL;
+  return (uint8_t const *)cf->map.data + hd->file_offset;
+}
+
 char *ChunkFile_readChunk(ChunkFile *cf, ChunkFile_EntHeader *hd) {
   char *out = malloc(hd->size);
   if (!out)
     return NULL;
 
+  void const *data = ChunkFile_chunkData(cf, hd);
+  if (data) {
+    memcpy(out, data, hd->size);
+    return out;
+  }
+
   fseek(cf->file, hd->file_offset, SEEK_SET);
   if (fread(out, 1, hd->size, cf->file) != hd->size) {
     free(out);
@@ -113,6 +170,13 @@ char const *ChunkFile_getStr(ChunkFile *cf, uint32_t strid) {
   if (!cf->headers.obj_strtab)
     return NULL;
 
+  if (strid >= cf->headers.obj_strtab->size)
+    return NULL;
+
+  char const *strtab = ChunkFile_chunkData(cf, cf->headers.obj_strtab);
+  if (strtab)
+    return strtab + strid;
+
   if (!cf->lazy_strtab) {
     cf->lazy_strtab = ChunkFile_readChunk(cf, cf->headers.obj_strtab);
 
@@ -120,8 +184,5 @@ char const *ChunkFile_getStr(ChunkFile *cf, uint32_t strid) {
       return NULL;
   }
 
-  if (strid >= cf->headers.obj_strtab->size)
-    return NULL;
-
   return cf->lazy_strtab + strid;
 }
@@ -0,0 +1,1734 @@
+#include "ubu/demangle.h"
+#include "ubu/utils.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEM_ARENA_BLOCK (64 * 1024)
+/** the caches are dropped once they use more than this */
+#define DEM_ARENA_LIMIT (64 * 1024 * 1024)
+#define DEM_MAX_DEPTH (256)
+/** nested-name fragments are keyed on (and at least) this many bytes */
+#define DEM_FRAG_KEY (16)
+
+struct DemArenaBlock {
+  DemArenaBlock *next;
+  size_t used;
+  size_t cap;
+  char data[];
+};
+
+static void *DemArena_alloc(DemArena *a, size_t bytes) {
+  bytes = (bytes + 7) & ~(size_t)7;
+  DemArenaBlock *b = a->head;
+  if (!b || b->cap - b->used < bytes) {
+    size_t cap = bytes > DEM_ARENA_BLOCK ? bytes : DEM_ARENA_BLOCK;
+    DemArenaBlock *n = malloc(sizeof(DemArenaBlock) + cap);
+    if (!n)
+      return NULL;
+    n->next = b;
+    n->used = 0;
+    n->cap = cap;
+    a->head = n;
+    a->size += cap;
+    b = n;
+  }
+  void *p = b->data + b->used;
+  b->used += bytes;
+  return p;
+}
+
+static void DemArena_free(DemArena *a) {
+  DemArenaBlock *b = a->head;
+  while (b) {
+    DemArenaBlock *next = b->next;
+    free(b);
+    b = next;
+  }
+  a->head = NULL;
+  a->size = 0;
+}
+
+/** keeps the newest block around so that the common case never mallocs */
+static void DemArena_reset(DemArena *a) {
+  DemArenaBlock *keep = a->head;
+  if (!keep)
+    return;
+  DemArenaBlock *b = keep->next;
+  while (b) {
+    DemArenaBlock *next = b->next;
+    free(b);
+    b = next;
+  }
+  keep->next = NULL;
+  keep->used = 0;
+  a->size = keep->cap;
+}
+
+void Demangler_init(Demangler *d) { memset(d, 0, sizeof(Demangler)); }
+
+void Demangler_free(Demangler *d) {
+  DemArena_free(&d->arena);
+  DemArena_free(&d->scratch);
+  free(d->subs);
+  free(d->tparams);
+  free(d->args);
+  free(d->names);
+  free(d->frags);
+  memset(d, 0, sizeof(Demangler));
+}
+
+static void Demangler_flush(Demangler *d) {
+  DemArena_free(&d->arena);
+  if (d->names)
+    memset(d->names, 0, sizeof(DemNameEnt) * d->names_cap);
+  d->names_len = 0;
+  if (d->frags)
+    memset(d->frags, 0, sizeof(DemFrag *) * d->frags_cap);
+  d->frags_len = 0;
+}
+
+typedef struct {
+  Demangler *d;
+  char const *p;
+  char const *end;
+  unsigned depth;
+  bool oom;
+  /** element of the pack that is being expanded by Dp, or -1 */
+  long pack_index;
+  /** length of the pack that was found while expanding, or -1 */
+  long pack_len;
+  /** parameters of a generic lambda refer to its own "auto" parameters */
+  bool in_lambda;
+  /** the next substitution of a template parameter is not resolved again */
+  bool keep_tparam;
+} DemParse;
+
+typedef struct {
+  DemStr str;
+  /** ends in template args; functions then have an encoded return type */
+  bool templ;
+  /** constructor, destructor or conversion operator */
+  bool no_ret;
+  /** cv and ref qualifiers of member functions */
+  DemStr quals;
+} DemName;
+
+#define DEM_LIT(s) ((DemStr){s, sizeof(s) - 1})
+
+static DemStr dem_str(char const *s) { return (DemStr){s, strlen(s)}; }
+
+static DemStr dem_catn(DemParse *ps, size_t n, DemStr const *parts) {
+  size_t len = 0;
+  for (size_t i = 0; i < n; i++)
+    len += parts[i].len;
+  char *out = DemArena_alloc(&ps->d->scratch, len + 1);
+  if (!out) {
+    ps->oom = true;
+    return DEM_LIT("");
+  }
+  size_t at = 0;
+  for (size_t i = 0; i < n; i++) {
+    // empty parts may have no string at all
+    if (!parts[i].len)
+      continue;
+    memcpy(out + at, parts[i].str, parts[i].len);
+    at += parts[i].len;
+  }
+  out[at] = '\0';
+  return (DemStr){out, len};
+}
+
+#define DEM_CAT(ps, ...)                                                       \
+  dem_catn(ps, sizeof((DemStr[]){__VA_ARGS__}) / sizeof(DemStr),               \
+           (DemStr[]){__VA_ARGS__})
+
+static DemStr dem_dup(DemArena *a, DemStr s, bool *oom) {
+  char *out = DemArena_alloc(a, s.len + 1);
+  if (!out) {
+    *oom = true;
+    return DEM_LIT("");
+  }
+  if (s.len)
+    memcpy(out, s.str, s.len);
+  out[s.len] = '\0';
+  return (DemStr){out, s.len};
+}
+
+static char dem_peek(DemParse *ps, size_t i) {
+  return (size_t)(ps->end - ps->p) > i ? ps->p[i] : '\0';
+}
+
+static bool dem_eat(DemParse *ps, char c) {
+  if (dem_peek(ps, 0) != c)
+    return false;
+  ps->p++;
+  return true;
+}
+
+static bool dem_eat2(DemParse *ps, char const *s) {
+  if (dem_peek(ps, 0) != s[0] || dem_peek(ps, 1) != s[1])
+    return false;
+  ps->p += 2;
+  return true;
+}
+
+static DemType dem_plain(DemStr s) { return (DemType){.pre = s}; }
+
+static DemStr dem_typeStr(DemParse *ps, DemType const *t) {
+  if (!t->post.len)
+    return t->pre;
+  return DEM_CAT(ps, t->pre, t->post);
+}
+
+static int dem_push(DemType **arr, size_t *len, size_t *cap, DemType t) {
+  if (*len == *cap) {
+    size_t ncap = *cap ? *cap * 2 : 32;
+    DemType *n = realloc(*arr, sizeof(DemType) * ncap);
+    if (!n)
+      return 1;
+    *arr = n;
+    *cap = ncap;
+  }
+  (*arr)[(*len)++] = t;
+  return 0;
+}
+
+static int dem_pushSub(DemParse *ps, DemType t) {
+  Demangler *d = ps->d;
+  if (dem_push(&d->subs, &d->subs_len, &d->subs_cap, t)) {
+    ps->oom = true;
+    return 1;
+  }
+  return 0;
+}
+
+/** 0 = ok */
+static int dem_number(DemParse *ps, size_t *out) {
+  if (!isdigit((unsigned char)dem_peek(ps, 0)))
+    return 1;
+  size_t v = 0;
+  while (isdigit((unsigned char)dem_peek(ps, 0))) {
+    v = v * 10 + (size_t)(*ps->p - '0');
+    ps->p++;
+  }
+  *out = v;
+  return 0;
+}
+
+/** [n] <number> */
+static int dem_snumber(DemParse *ps) {
+  size_t ignored;
+  dem_eat(ps, 'n');
+  return dem_number(ps, &ignored);
+}
+
+/** <seq-id> _ ; returns 0 for a lone '_', otherwise the base-36 value + 1 */
+static int dem_seqId(DemParse *ps, size_t *out) {
+  if (dem_eat(ps, '_')) {
+    *out = 0;
+    return 0;
+  }
+  size_t v = 0;
+  bool any = false;
+  for (;;) {
+    char c = dem_peek(ps, 0);
+    if (isdigit((unsigned char)c))
+      v = v * 36 + (size_t)(c - '0');
+    else if (c >= 'A' && c <= 'Z')
+      v = v * 36 + (size_t)(c - 'A' + 10);
+    else
+      break;
+    any = true;
+    ps->p++;
+  }
+  if (!any || !dem_eat(ps, '_'))
+    return 1;
+  *out = v + 1;
+  return 0;
+}
+
+/** _ <digit> | __ <number> _ */
+static void dem_discriminator(DemParse *ps) {
+  if (dem_peek(ps, 0) != '_')
+    return;
+  if (isdigit((unsigned char)dem_peek(ps, 1))) {
+    ps->p += 2;
+  } else if (dem_peek(ps, 1) == '_') {
+    ps->p += 2;
+    size_t ignored;
+    if (!dem_number(ps, &ignored))
+      dem_eat(ps, '_');
+  }
+}
+
+static int dem_sourceName(DemParse *ps, DemStr *out) {
+  size_t len;
+  if (dem_number(ps, &len))
+    return 1;
+  if (len == 0 || len > (size_t)(ps->end - ps->p))
+    return 1;
+  DemStr s = {ps->p, len};
+  ps->p += len;
+  if (len >= 10 && !memcmp(s.str, "_GLOBAL_", 8) &&
+      strchr("._$", s.str[8]) && s.str[9] == 'N')
+    s = DEM_LIT("(anonymous namespace)");
+  *out = s;
+  return 0;
+}
+
+static char const *dem_builtin(char c) {
+  switch (c) {
+  case 'v': return "void";
+  case 'w': return "wchar_t";
+  case 'b': return "bool";
+  case 'c': return "char";
+  case 'a': return "signed char";
+  case 'h': return "unsigned char";
+  case 's': return "short";
+  case 't': return "unsigned short";
+  case 'i': return "int";
+  case 'j': return "unsigned int";
+  case 'l': return "long";
+  case 'm': return "unsigned long";
+  case 'x': return "long long";
+  case 'y': return "unsigned long long";
+  case 'n': return "__int128";
+  case 'o': return "unsigned __int128";
+  case 'f': return "float";
+  case 'd': return "double";
+  case 'e': return "long double";
+  case 'g': return "__float128";
+  case 'z': return "...";
+  default: return NULL;
+  }
+}
+
+static char const *dem_builtinD(char c) {
+  switch (c) {
+  case 'a': return "auto";
+  case 'c': return "decltype(auto)";
+  case 'n': return "decltype(nullptr)";
+  case 'd': return "decimal64";
+  case 'e': return "decimal128";
+  case 'f': return "decimal32";
+  case 'h': return "half";
+  case 'i': return "char32_t";
+  case 's': return "char16_t";
+  case 'u': return "char8_t";
+  default: return NULL;
+  }
+}
+
+static struct {
+  char code[3];
+  char const *name;
+} const dem_operators[] = {
+    {"nw", "operator new"},  {"na", "operator new[]"},
+    {"dl", "operator delete"}, {"da", "operator delete[]"},
+    {"ps", "operator+"},     {"ng", "operator-"},
+    {"ad", "operator&"},     {"de", "operator*"},
+    {"co", "operator~"},     {"pl", "operator+"},
+    {"mi", "operator-"},     {"ml", "operator*"},
+    {"dv", "operator/"},     {"rm", "operator%"},
+    {"an", "operator&"},     {"or", "operator|"},
+    {"eo", "operator^"},     {"aS", "operator="},
+    {"pL", "operator+="},    {"mI", "operator-="},
+    {"mL", "operator*="},    {"dV", "operator/="},
+    {"rM", "operator%="},    {"aN", "operator&="},
+    {"oR", "operator|="},    {"eO", "operator^="},
+    {"ls", "operator<<"},    {"rs", "operator>>"},
+    {"lS", "operator<<="},   {"rS", "operator>>="},
+    {"eq", "operator=="},    {"ne", "operator!="},
+    {"lt", "operator<"},     {"gt", "operator>"},
+    {"le", "operator<="},    {"ge", "operator>="},
+    {"ss", "operator<=>"},   {"nt", "operator!"},
+    {"aa", "operator&&"},    {"oo", "operator||"},
+    {"pp", "operator++"},    {"mm", "operator--"},
+    {"cm", "operator,"},     {"pm", "operator->*"},
+    {"pt", "operator->"},    {"cl", "operator()"},
+    {"ix", "operator[]"},    {"qu", "operator?"},
+    {"aw", "operator co_await"},
+};
+
+static int dem_type(DemParse *ps, DemType *out);
+static int dem_name(DemParse *ps, DemName *out, bool top);
+static int dem_encoding(DemParse *ps, DemStr *out, bool top);
+
+/**
+ * the class name of a scope ("ns::A<int>" -> "A"), for constructors;
+ * unnamed types use the name of the enclosing class like c++filt does
+ */
+static DemStr dem_baseName(DemStr scope) {
+  int depth = 0;
+  size_t start = 0, prev = 0;
+  for (size_t i = 0; i < scope.len; i++) {
+    char c = scope.str[i];
+    if (c == '<' || c == '(' || c == '{')
+      depth++;
+    else if (c == '>' || c == ')' || c == '}')
+      depth--;
+    else if (depth == 0 && c == ':' && i + 1 < scope.len &&
+             scope.str[i + 1] == ':') {
+      prev = start;
+      start = i + 2;
+    }
+  }
+  if (start < scope.len && scope.str[start] == '{')
+    start = prev;
+  size_t end = start;
+  // no template arguments or abi tags
+  while (end < scope.len && scope.str[end] != '<' && scope.str[end] != '[' &&
+         scope.str[end] != ':')
+    end++;
+  return (DemStr){scope.str + start, end - start};
+}
+
+static DemStr dem_cvQuals(DemParse *ps) {
+  bool r = dem_eat(ps, 'r');
+  bool v = dem_eat(ps, 'V');
+  bool k = dem_eat(ps, 'K');
+  DemStr q = DEM_LIT("");
+  if (k)
+    q = DEM_LIT(" const");
+  if (v)
+    q = DEM_CAT(ps, q, DEM_LIT(" volatile"));
+  if (r)
+    q = DEM_CAT(ps, q, DEM_LIT(" restrict"));
+  return q;
+}
+
+/** true if [s] ends in a run of cv-qualifiers that contains [q] (" const") */
+static bool dem_hasQual(DemStr s, DemStr q) {
+  static DemStr const quals[] = {DEM_LIT(" const"), DEM_LIT(" volatile"),
+                                 DEM_LIT(" restrict")};
+  for (;;) {
+    bool stripped = false;
+    for (size_t i = 0; i < sizeof(quals) / sizeof(quals[0]); i++) {
+      DemStr w = quals[i];
+      if (s.len < w.len || memcmp(s.str + s.len - w.len, w.str, w.len))
+        continue;
+      if (w.len == q.len && !memcmp(w.str, q.str, q.len))
+        return true;
+      s.len -= w.len;
+      stripped = true;
+    }
+    if (!stripped)
+      return false;
+  }
+}
+
+/** appends the qualifiers of [q] that [s] does not end in yet, like c++filt */
+static DemStr dem_addQuals(DemParse *ps, DemStr s, DemStr q) {
+  static DemStr const quals[] = {DEM_LIT(" const"), DEM_LIT(" volatile"),
+                                 DEM_LIT(" restrict")};
+  for (size_t i = 0; i < sizeof(quals) / sizeof(quals[0]); i++) {
+    DemStr w = quals[i];
+    bool in_q = false;
+    for (size_t j = 0; j + w.len <= q.len; j++)
+      if (!memcmp(q.str + j, w.str, w.len) &&
+          (j + w.len == q.len || q.str[j + w.len] == ' '))
+        in_q = true;
+    if (in_q && !dem_hasQual(s, w))
+      s = DEM_CAT(ps, s, w);
+  }
+  return s;
+}
+
+static DemType dem_qualify(DemParse *ps, DemType t, DemStr q) {
+  if (t.needs_paren && t.post.len && t.post.str[0] == '[') {
+    // cv-qualified array is an array of cv-qualified elements
+    DemStr el = t.pre;
+    if (el.len && el.str[el.len - 1] == ' ')
+      el.len--;
+    t.pre = DEM_CAT(ps, dem_addQuals(ps, el, q), DEM_LIT(" "));
+  } else if (t.needs_paren)
+    t.post = dem_addQuals(ps, t.post, q);
+  else
+    t.pre = dem_addQuals(ps, t.pre, q);
+  return t;
+}
+
+/**
+ * [space]: like c++filt, member pointers are always separated from what comes
+ * before them, other declarators only from names
+ */
+static DemType dem_declarator(DemParse *ps, DemType t, DemStr decl,
+                              bool space) {
+  if (t.needs_paren) {
+    char last = t.pre.len ? t.pre.str[t.pre.len - 1] : ' ';
+    bool sep = last != ' ' && (space || (last != '(' && last != '*'));
+    t.pre = DEM_CAT(ps, t.pre, sep ? DEM_LIT(" (") : DEM_LIT("("), decl);
+    t.post = DEM_CAT(ps, t.post.str[0] == '[' ? DEM_LIT(") ") : DEM_LIT(")"),
+                     t.post);
+    t.needs_paren = false;
+  } else {
+    t.pre = DEM_CAT(ps, t.pre, decl);
+  }
+  return t;
+}
+
+static int dem_paramAt(DemParse *ps, size_t idx, DemType *out) {
+  if (idx >= ps->d->tparams_len)
+    return 1;
+  *out = ps->d->tparams[idx];
+  if (out->is_pack && ps->pack_index >= 0) {
+    ps->pack_len = (long)out->nelems;
+    if ((size_t)ps->pack_index < out->nelems)
+      *out = out->elems[ps->pack_index];
+    else
+      *out = dem_plain(DEM_LIT(""));
+  }
+  return 0;
+}
+
+/** T_ | T <number> _ */
+static int dem_templateParam(DemParse *ps, DemType *out, size_t *idx_out) {
+  if (!dem_eat(ps, 'T'))
+    return 1;
+  size_t idx = 0;
+  if (!dem_eat(ps, '_')) {
+    if (dem_number(ps, &idx) || !dem_eat(ps, '_'))
+      return 1;
+    idx++;
+  }
+  if (idx_out)
+    *idx_out = idx;
+  if (ps->in_lambda) {
+    char num[24];
+    sprintf(num, "%zu", idx + 1);
+    *out = dem_plain(DEM_CAT(ps, DEM_LIT("auto:"), dem_str(num)));
+    return 0;
+  }
+  return dem_paramAt(ps, idx, out);
+}
+
+static int dem_templateArgs(DemParse *ps, DemStr *out, bool setParams);
+
+/** L <type> <value> E | L _Z <encoding> E */
+static int dem_literal(DemParse *ps, DemStr *out) {
+  if (!dem_eat(ps, 'L'))
+    return 1;
+
+  if (dem_eat2(ps, "_Z")) {
+    if (dem_encoding(ps, out, true))
+      return 1;
+    return dem_eat(ps, 'E') ? 0 : 1;
+  }
+
+  char tyc = dem_peek(ps, 0);
+  DemType ty;
+  if (dem_type(ps, &ty))
+    return 1;
+
+  bool neg = dem_eat(ps, 'n');
+  char const *vstart = ps->p;
+  while (ps->p < ps->end && *ps->p != 'E')
+    ps->p++;
+  if (!dem_eat(ps, 'E'))
+    return 1;
+  DemStr val = {vstart, (size_t)(ps->p - 1 - vstart)};
+  DemStr sign = neg ? DEM_LIT("-") : DEM_LIT("");
+
+  switch (tyc) {
+  case 'b':
+    // other values are printed as a cast, like c++filt does
+    if (!neg && val.len == 1 && (val.str[0] == '0' || val.str[0] == '1')) {
+      *out = val.str[0] == '0' ? DEM_LIT("false") : DEM_LIT("true");
+      return 0;
+    }
+    break;
+  case 'i':
+    *out = DEM_CAT(ps, sign, val);
+    return 0;
+  case 'j':
+    *out = DEM_CAT(ps, sign, val, DEM_LIT("u"));
+    return 0;
+  case 'l':
+    *out = DEM_CAT(ps, sign, val, DEM_LIT("l"));
+    return 0;
+  case 'm':
+    *out = DEM_CAT(ps, sign, val, DEM_LIT("ul"));
+    return 0;
+  case 'x':
+    *out = DEM_CAT(ps, sign, val, DEM_LIT("ll"));
+    return 0;
+  case 'y':
+    *out = DEM_CAT(ps, sign, val, DEM_LIT("ull"));
+    return 0;
+  default:
+    break;
+  }
+  *out = DEM_CAT(ps, DEM_LIT("("), dem_typeStr(ps, &ty), DEM_LIT(")"), sign,
+                 val);
+  return 0;
+}
+
+static int dem_templateArg(DemParse *ps, DemType *out) {
+  char c = dem_peek(ps, 0);
+  if (c == 'L') {
+    DemStr s;
+    if (dem_literal(ps, &s))
+      return 1;
+    *out = dem_plain(s);
+    return 0;
+  }
+  if (c == 'J' || c == 'I') { // I: argument pack of old compilers
+    Demangler *d = ps->d;
+    ps->p++;
+    size_t base = d->args_len;
+    DemStr s = DEM_LIT("");
+    while (!dem_eat(ps, 'E')) {
+      DemType a;
+      if (ps->p >= ps->end || dem_templateArg(ps, &a))
+        return 1;
+      if (dem_push(&d->args, &d->args_len, &d->args_cap, a)) {
+        ps->oom = true;
+        return 1;
+      }
+      DemStr as = dem_typeStr(ps, &a);
+      s = d->args_len - base == 1 ? as : DEM_CAT(ps, s, DEM_LIT(", "), as);
+    }
+    size_t n = d->args_len - base;
+    DemType *elems = DemArena_alloc(&d->scratch, sizeof(DemType) * (n + 1));
+    if (!elems) {
+      ps->oom = true;
+      return 1;
+    }
+    if (n)
+      memcpy(elems, d->args + base, sizeof(DemType) * n);
+    d->args_len = base;
+    *out = dem_plain(s);
+    out->elems = elems;
+    out->nelems = n;
+    out->is_pack = true;
+    return 0;
+  }
+  if (c == 'X') // expressions
+    return 1;
+  return dem_type(ps, out);
+}
+
+/** I <template-arg>+ E */
+static int dem_templateArgs(DemParse *ps, DemStr *out, bool setParams) {
+  Demangler *d = ps->d;
+  if (!dem_eat(ps, 'I'))
+    return 1;
+
+  size_t base = d->args_len;
+  DemStr s = DEM_LIT("<");
+  DemStr last = DEM_LIT("");
+  bool first = true;
+  while (!dem_eat(ps, 'E')) {
+    DemType a;
+    if (ps->p >= ps->end || dem_templateArg(ps, &a))
+      return 1;
+    if (dem_push(&d->args, &d->args_len, &d->args_cap, a)) {
+      ps->oom = true;
+      return 1;
+    }
+    DemStr as = dem_typeStr(ps, &a);
+    last = as;
+    if (!as.len) // empty pack
+      continue;
+    s = first ? DEM_CAT(ps, s, as) : DEM_CAT(ps, s, DEM_LIT(", "), as);
+    first = false;
+  }
+
+  if (last.len && last.str[last.len - 1] == '>')
+    s = DEM_CAT(ps, s, DEM_LIT(" >"));
+  else
+    s = DEM_CAT(ps, s, DEM_LIT(">"));
+
+  if (setParams) {
+    d->tparams_len = 0;
+    for (size_t i = base; i < d->args_len; i++) {
+      if (dem_push(&d->tparams, &d->tparams_len, &d->tparams_cap,
+                   d->args[i])) {
+        ps->oom = true;
+        return 1;
+      }
+    }
+  }
+  d->args_len = base;
+
+  *out = s;
+  return 0;
+}
+
+/** "operator<" followed by "<int>" needs a space */
+static DemStr dem_withArgs(DemParse *ps, DemStr name, DemStr args) {
+  if (name.len && name.str[name.len - 1] == '<')
+    return DEM_CAT(ps, name, DEM_LIT(" "), args);
+  return DEM_CAT(ps, name, args);
+}
+
+/**
+ * S_ | S <seq-id> _ | Sa | Sb | Ss | Si | So | Sd
+ * (like c++filt, the std:: abbreviations are always fully expanded)
+ */
+static int dem_substitution(DemParse *ps, DemType *out) {
+  if (!dem_eat(ps, 'S'))
+    return 1;
+
+  char const *abbrev = NULL;
+  switch (dem_peek(ps, 0)) {
+  case 'a':
+    abbrev = "std::allocator";
+    break;
+  case 'b':
+    abbrev = "std::basic_string";
+    break;
+  case 's':
+    abbrev = "std::basic_string<char, std::char_traits<char>, "
+             "std::allocator<char> >";
+    break;
+  case 'i':
+    abbrev = "std::basic_istream<char, std::char_traits<char> >";
+    break;
+  case 'o':
+    abbrev = "std::basic_ostream<char, std::char_traits<char> >";
+    break;
+  case 'd':
+    abbrev = "std::basic_iostream<char, std::char_traits<char> >";
+    break;
+  default:
+    break;
+  }
+  if (abbrev) {
+    ps->p++;
+    *out = dem_plain(dem_str(abbrev));
+    return 0;
+  }
+
+  size_t idx;
+  if (dem_seqId(ps, &idx) || idx >= ps->d->subs_len)
+    return 1;
+  *out = ps->d->subs[idx];
+  bool keep = ps->keep_tparam;
+  ps->keep_tparam = false;
+  if (!keep && !ps->in_lambda && out->tparam &&
+      out->tparam <= ps->d->tparams_len)
+    return dem_paramAt(ps, out->tparam - 1, out);
+  return 0;
+}
+
+static int dem_operatorName(DemParse *ps, DemName *out) {
+  if (dem_eat2(ps, "cv")) {
+    DemType t;
+    if (dem_type(ps, &t))
+      return 1;
+    out->str = DEM_CAT(ps, DEM_LIT("operator "), dem_typeStr(ps, &t));
+    out->no_ret = true;
+    return 0;
+  }
+  if (dem_eat2(ps, "li")) {
+    DemStr n;
+    if (dem_sourceName(ps, &n))
+      return 1;
+    out->str = DEM_CAT(ps, DEM_LIT("operator\"\" "), n);
+    return 0;
+  }
+  if (dem_peek(ps, 0) == 'v' && isdigit((unsigned char)dem_peek(ps, 1))) {
+    ps->p += 2;
+    DemStr n;
+    if (dem_sourceName(ps, &n))
+      return 1;
+    out->str = DEM_CAT(ps, DEM_LIT("operator "), n);
+    return 0;
+  }
+
+  char a = dem_peek(ps, 0), b = dem_peek(ps, 1);
+  for (size_t i = 0; i < sizeof(dem_operators) / sizeof(dem_operators[0]);
+       i++) {
+    if (dem_operators[i].code[0] == a && dem_operators[i].code[1] == b) {
+      ps->p += 2;
+      out->str = dem_str(dem_operators[i].name);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/** Ul <lambda-sig> E [<number>] _ | Ut [<number>] _ */
+static int dem_unnamedTypeName(DemParse *ps, DemStr *out) {
+  if (dem_eat2(ps, "Ut")) {
+    size_t n = 0;
+    if (!dem_eat(ps, '_')) {
+      if (dem_number(ps, &n) || !dem_eat(ps, '_'))
+        return 1;
+      n++;
+    }
+    char num[24];
+    sprintf(num, "%zu", n + 1);
+    *out = DEM_CAT(ps, DEM_LIT("{unnamed type#"), dem_str(num), DEM_LIT("}"));
+    return 0;
+  }
+
+  if (!dem_eat2(ps, "Ul"))
+    return 1;
+
+  DemStr sig = DEM_LIT("(");
+  bool first = true;
+  bool in_lambda = ps->in_lambda;
+  ps->in_lambda = true;
+  while (!dem_eat(ps, 'E')) {
+    char const *before = ps->p;
+    DemType t;
+    if (ps->p >= ps->end || dem_type(ps, &t))
+      return 1;
+    if (first && ps->p - before == 1 && *before == 'v' &&
+        dem_peek(ps, 0) == 'E')
+      continue;
+    DemStr ts = dem_typeStr(ps, &t);
+    sig = first ? DEM_CAT(ps, sig, ts) : DEM_CAT(ps, sig, DEM_LIT(", "), ts);
+    first = false;
+  }
+  ps->in_lambda = in_lambda;
+  size_t n = 0;
+  if (!dem_eat(ps, '_')) {
+    if (dem_number(ps, &n) || !dem_eat(ps, '_'))
+      return 1;
+    n++;
+  }
+  char num[24];
+  sprintf(num, "%zu", n + 1);
+  *out = DEM_CAT(ps, DEM_LIT("{lambda"), sig, DEM_LIT(")#"), dem_str(num),
+                 DEM_LIT("}"));
+  return 0;
+}
+
+/** [scope] is the enclosing name, needed for constructors and destructors */
+static int dem_unqualifiedName(DemParse *ps, DemStr scope, DemName *out) {
+  memset(out, 0, sizeof(DemName));
+
+  char c = dem_peek(ps, 0);
+  if (isdigit((unsigned char)c)) {
+    if (dem_sourceName(ps, &out->str))
+      return 1;
+  } else if (c == 'L') {
+    // internal linkage
+    ps->p++;
+    if (dem_sourceName(ps, &out->str))
+      return 1;
+    dem_discriminator(ps);
+  } else if (c == 'C') {
+    ps->p++;
+    bool inheriting = dem_eat(ps, 'I');
+    char k = dem_peek(ps, 0);
+    if (k < '1' || k > '5')
+      return 1;
+    ps->p++;
+    if (inheriting) {
+      DemType base;
+      if (dem_type(ps, &base))
+        return 1;
+    }
+    if (!scope.len)
+      return 1;
+    out->str = dem_baseName(scope);
+    out->no_ret = true;
+  } else if (c == 'D' && strchr("0125", dem_peek(ps, 1)) && dem_peek(ps, 1)) {
+    ps->p += 2;
+    if (!scope.len)
+      return 1;
+    out->str = DEM_CAT(ps, DEM_LIT("~"), dem_baseName(scope));
+    out->no_ret = true;
+  } else if (c == 'U') {
+    if (dem_unnamedTypeName(ps, &out->str))
+      return 1;
+  } else if (islower((unsigned char)c)) {
+    if (dem_operatorName(ps, out))
+      return 1;
+  } else {
+    return 1;
+  }
+
+  // abi tags
+  while (dem_eat(ps, 'B')) {
+    DemStr tag;
+    if (dem_sourceName(ps, &tag))
+      return 1;
+    out->str = DEM_CAT(ps, out->str, DEM_LIT("[abi:"), tag, DEM_LIT("]"));
+  }
+
+  return 0;
+}
+
+/** N [<CV-qualifiers>] [<ref-qualifier>] <prefix> <unqualified-name> E */
+static int dem_nestedName(DemParse *ps, DemName *out, bool top) {
+  memset(out, 0, sizeof(DemName));
+  if (!dem_eat(ps, 'N'))
+    return 1;
+
+  out->quals = dem_cvQuals(ps);
+  if (dem_eat(ps, 'R'))
+    out->quals = DEM_CAT(ps, out->quals, DEM_LIT(" &"));
+  else if (dem_eat(ps, 'O'))
+    out->quals = DEM_CAT(ps, out->quals, DEM_LIT(" &&"));
+
+  DemStr so_far = DEM_LIT("");
+  bool have = false;
+  bool last_pushed = false;
+  while (!dem_eat(ps, 'E')) {
+    char c = dem_peek(ps, 0);
+    if (!c)
+      return 1;
+
+    if (c == 'S' && dem_peek(ps, 1) == 't') {
+      if (have)
+        return 1;
+      ps->p += 2;
+      so_far = DEM_LIT("std");
+      have = true;
+      last_pushed = false;
+      continue;
+    }
+    if (c == 'S') {
+      // substitutions are not candidates again
+      DemType sub;
+      if (have || dem_substitution(ps, &sub))
+        return 1;
+      so_far = dem_typeStr(ps, &sub);
+      have = true;
+      last_pushed = false;
+      continue;
+    }
+    if (c == 'M') {
+      // closure context of lambdas in initializers
+      ps->p++;
+      continue;
+    }
+
+    if (c == 'I') {
+      DemStr args;
+      if (!have || dem_templateArgs(ps, &args, top))
+        return 1;
+      so_far = dem_withArgs(ps, so_far, args);
+      out->templ = true;
+    } else if (c == 'T') {
+      DemType t;
+      if (have || dem_templateParam(ps, &t, NULL))
+        return 1;
+      so_far = dem_typeStr(ps, &t);
+      out->templ = false;
+    } else {
+      DemName un;
+      if (dem_unqualifiedName(ps, have ? so_far : DEM_LIT(""), &un))
+        return 1;
+      so_far = have ? DEM_CAT(ps, so_far, DEM_LIT("::"), un.str) : un.str;
+      out->templ = false;
+      out->no_ret = un.no_ret;
+    }
+
+    have = true;
+    if (dem_pushSub(ps, dem_plain(so_far)))
+      return 1;
+    last_pushed = true;
+  }
+
+  if (!have)
+    return 1;
+  // the complete name is not a prefix
+  if (last_pushed)
+    ps->d->subs_len--;
+
+  out->str = so_far;
+  return 0;
+}
+
+/** Z <function encoding> E <entity name> [<discriminator>] */
+static int dem_localName(DemParse *ps, DemName *out, bool top) {
+  memset(out, 0, sizeof(DemName));
+  if (!dem_eat(ps, 'Z'))
+    return 1;
+
+  DemStr enc;
+  // like c++filt, the enclosing function is printed without return type
+  if (dem_encoding(ps, &enc, false) || !dem_eat(ps, 'E'))
+    return 1;
+
+  if (dem_eat(ps, 's')) {
+    dem_discriminator(ps);
+    out->str = DEM_CAT(ps, enc, DEM_LIT("::string literal"));
+    return 0;
+  }
+
+  if (dem_eat(ps, 'd')) {
+    size_t arg = 0;
+    if (dem_peek(ps, 0) != '_') {
+      if (dem_number(ps, &arg))
+        return 1;
+      arg++;
+    }
+    if (!dem_eat(ps, '_'))
+      return 1;
+    char num[24];
+    sprintf(num, "%zu", arg + 1);
+    enc = DEM_CAT(ps, enc, DEM_LIT("::{default arg#"),
+                  dem_str(num), DEM_LIT("}"));
+  }
+
+  DemName ent;
+  if (dem_name(ps, &ent, top))
+    return 1;
+  dem_discriminator(ps);
+
+  *out = ent;
+  out->str = DEM_CAT(ps, enc, DEM_LIT("::"), ent.str);
+  return 0;
+}
+
+static int dem_name(DemParse *ps, DemName *out, bool top) {
+  memset(out, 0, sizeof(DemName));
+
+  char c = dem_peek(ps, 0);
+  if (c == 'N')
+    return dem_nestedName(ps, out, top);
+  if (c == 'Z')
+    return dem_localName(ps, out, top);
+
+  if (c == 'S' && dem_peek(ps, 1) != 't') {
+    // <unscoped-template-name> that has been seen before
+    DemType sub;
+    DemStr args;
+    if (dem_substitution(ps, &sub) ||
+        dem_templateArgs(ps, &args, top))
+      return 1;
+    out->str = dem_withArgs(ps, dem_typeStr(ps, &sub), args);
+    out->templ = true;
+    return 0;
+  }
+
+  bool in_std = dem_eat2(ps, "St");
+  DemName un;
+  if (dem_unqualifiedName(ps, DEM_LIT(""), &un))
+    return 1;
+  *out = un;
+  if (in_std)
+    out->str = DEM_CAT(ps, DEM_LIT("std::"), un.str);
+
+  if (dem_peek(ps, 0) == 'I') {
+    DemStr args;
+    if (dem_pushSub(ps, dem_plain(out->str)) ||
+        dem_templateArgs(ps, &args, top))
+      return 1;
+    out->str = dem_withArgs(ps, out->str, args);
+    out->templ = true;
+  }
+
+  return 0;
+}
+
+/** [dem_paramsEnd] decides where a parameter list ends */
+static bool dem_paramsEnd(DemParse *ps, bool fnType) {
+  char c = dem_peek(ps, 0);
+  if (c == '\0' || c == 'E' || c == '.')
+    return true;
+  return fnType && (c == 'R' || c == 'O') && dem_peek(ps, 1) == 'E';
+}
+
+static int dem_params(DemParse *ps, DemStr *out, bool fnType) {
+  DemStr s = DEM_LIT("(");
+  bool first = true;
+  while (!dem_paramsEnd(ps, fnType)) {
+    char const *before = ps->p;
+    DemType t;
+    if (dem_type(ps, &t))
+      return 1;
+    // (v) is an empty parameter list
+    if (first && ps->p - before == 1 && *before == 'v' &&
+        dem_paramsEnd(ps, fnType))
+      break;
+    DemStr ts = dem_typeStr(ps, &t);
+    if (!ts.len) // expansion of an empty pack
+      continue;
+    s = first ? DEM_CAT(ps, s, ts) : DEM_CAT(ps, s, DEM_LIT(", "), ts);
+    first = false;
+  }
+  *out = DEM_CAT(ps, s, DEM_LIT(")"));
+  return 0;
+}
+
+/** only nested names without back references can be reused across names */
+static bool dem_fragContextFree(char const *s, size_t len) {
+  for (size_t i = 0; i + 1 < len; i++) {
+    char n = s[i + 1];
+    if (s[i] == 'S' && (n == '_' || isdigit((unsigned char)n) ||
+                        (n >= 'A' && n <= 'Z')))
+      return false;
+    if (s[i] == 'T' && (n == '_' || n == 'L' || isdigit((unsigned char)n)))
+      return false;
+  }
+  return true;
+}
+
+static bool dem_fragLookup(DemParse *ps, DemType *out) {
+  Demangler *d = ps->d;
+  size_t rem = (size_t)(ps->end - ps->p);
+  if (!d->frags_cap || rem < DEM_FRAG_KEY)
+    return false;
+
+  uint64_t h = hash((unsigned char const *)ps->p, DEM_FRAG_KEY);
+  for (size_t i = h & (d->frags_cap - 1);; i = (i + 1) & (d->frags_cap - 1)) {
+    DemFrag *f = d->frags[i];
+    if (!f)
+      return false;
+    if (f->hash != h || f->span.len > rem ||
+        memcmp(f->span.str, ps->p, f->span.len))
+      continue;
+
+    for (size_t s = 0; s < f->nsubs; s++)
+      if (dem_pushSub(ps, f->subs[s]))
+        return false;
+    ps->p += f->span.len;
+    *out = f->result;
+    return true;
+  }
+}
+
+static void dem_fragStore(DemParse *ps, char const *start, size_t nsubs0,
+                          DemType const *result) {
+  Demangler *d = ps->d;
+  size_t len = (size_t)(ps->p - start);
+  if (len < DEM_FRAG_KEY || !dem_fragContextFree(start, len))
+    return;
+
+  if ((d->frags_len + 1) * 2 > d->frags_cap) {
+    size_t ncap = d->frags_cap ? d->frags_cap * 2 : 256;
+    DemFrag **n = calloc(ncap, sizeof(DemFrag *));
+    if (!n)
+      return;
+    for (size_t i = 0; i < d->frags_cap; i++) {
+      DemFrag *f = d->frags[i];
+      if (!f)
+        continue;
+      size_t j = f->hash & (ncap - 1);
+      while (n[j])
+        j = (j + 1) & (ncap - 1);
+      n[j] = f;
+    }
+    free(d->frags);
+    d->frags = n;
+    d->frags_cap = ncap;
+  }
+
+  bool oom = false;
+  size_t nsubs = d->subs_len - nsubs0;
+  DemFrag *f = DemArena_alloc(&d->arena, sizeof(DemFrag));
+  DemType *subs = DemArena_alloc(&d->arena, sizeof(DemType) * (nsubs + 1));
+  if (!f || !subs)
+    return;
+  f->hash = hash((unsigned char const *)start, DEM_FRAG_KEY);
+  f->span = dem_dup(&d->arena, (DemStr){start, len}, &oom);
+  f->result = *result;
+  f->result.pre = dem_dup(&d->arena, result->pre, &oom);
+  f->result.post = dem_dup(&d->arena, result->post, &oom);
+  for (size_t i = 0; i < nsubs; i++) {
+    DemType const *s = &d->subs[nsubs0 + i];
+    subs[i] = *s;
+    subs[i].pre = dem_dup(&d->arena, s->pre, &oom);
+    subs[i].post = dem_dup(&d->arena, s->post, &oom);
+  }
+  f->subs = subs;
+  f->nsubs = nsubs;
+  if (oom)
+    return;
+
+  size_t j = f->hash & (d->frags_cap - 1);
+  while (d->frags[j])
+    j = (j + 1) & (d->frags_cap - 1);
+  d->frags[j] = f;
+  d->frags_len++;
+}
+
+/** [noexcept_]: Do prefix */
+static int dem_functionType(DemParse *ps, DemType *out, bool noexcept_) {
+  if (!dem_eat(ps, 'F'))
+    return 1;
+  dem_eat(ps, 'Y'); // extern "C"
+
+  DemType ret;
+  DemStr params;
+  if (dem_type(ps, &ret) || dem_params(ps, &params, true))
+    return 1;
+
+  if (dem_eat(ps, 'R'))
+    params = DEM_CAT(ps, params, DEM_LIT(" &"));
+  else if (dem_eat(ps, 'O'))
+    params = DEM_CAT(ps, params, DEM_LIT(" &&"));
+
+  if (!dem_eat(ps, 'E'))
+    return 1;
+  if (noexcept_)
+    params = DEM_CAT(ps, params, DEM_LIT(" noexcept"));
+
+  *out = (DemType){0};
+  if (ret.post.len) {
+    // returns a pointer to function or array: the declarator goes inside of
+    // the one of the return type, int (*(*)())()
+    out->pre = ret.pre;
+    out->post = DEM_CAT(ps, params, ret.post);
+  } else {
+    out->pre = DEM_CAT(ps, ret.pre, DEM_LIT(" "));
+    out->post = params;
+  }
+  out->needs_paren = true;
+  return 0;
+}
+
+static int dem_type_(DemParse *ps, DemType *out) {
+  char c = dem_peek(ps, 0);
+  *out = (DemType){0};
+
+  char const *builtin = dem_builtin(c);
+  if (builtin) {
+    ps->p++;
+    *out = dem_plain(dem_str(builtin));
+    return 0;
+  }
+
+  switch (c) {
+  case 'u': {
+    ps->p++;
+    DemStr n;
+    if (dem_sourceName(ps, &n))
+      return 1;
+    *out = dem_plain(n);
+    break;
+  }
+
+  case 'r':
+  case 'V':
+  case 'K': {
+    DemStr q = dem_cvQuals(ps);
+    DemType inner;
+    // the qualifiers of a member function type apply to this, only the
+    // qualified function type is a substitution candidate
+    if (dem_peek(ps, 0) == 'F' ? dem_functionType(ps, &inner, false)
+                               : dem_type(ps, &inner))
+      return 1;
+    *out = dem_qualify(ps, inner, q);
+    break;
+  }
+
+  case 'P':
+  case 'R':
+  case 'O': {
+    ps->p++;
+    DemType inner;
+    // like c++filt, references to template parameters keep the template
+    // arguments they were first seen with
+    ps->keep_tparam = c != 'P' && dem_peek(ps, 0) == 'S';
+    if (dem_type(ps, &inner))
+      return 1;
+    ps->keep_tparam = false;
+    if (c != 'P' && inner.ref) {
+      // reference collapsing: only && && stays an rvalue reference
+      if (c == 'R' && inner.ref == 'O') {
+        inner.pre.len--;
+        inner.ref = '&';
+      }
+      *out = inner;
+      break;
+    }
+    *out = dem_declarator(ps, inner,
+                          c == 'P'   ? DEM_LIT("*")
+                          : c == 'R' ? DEM_LIT("&")
+                                     : DEM_LIT("&&"),
+                          false);
+    out->ref = c == 'P' ? 0 : (c == 'R' ? '&' : 'O');
+    break;
+  }
+
+  case 'C':
+  case 'G': {
+    ps->p++;
+    DemType inner;
+    if (dem_type(ps, &inner))
+      return 1;
+    *out = dem_plain(DEM_CAT(ps, dem_typeStr(ps, &inner),
+                             c == 'C' ? DEM_LIT(" _Complex")
+                                      : DEM_LIT(" _Imaginary")));
+    break;
+  }
+
+  case 'F':
+    if (dem_functionType(ps, out, false))
+      return 1;
+    break;
+
+  case 'A': {
+    ps->p++;
+    DemStr dims;
+    if (dem_peek(ps, 0) == 'T') {
+      DemType param;
+      if (dem_templateParam(ps, &param, NULL))
+        return 1;
+      dims = dem_typeStr(ps, &param);
+    } else {
+      char const *dim = ps->p;
+      while (isdigit((unsigned char)dem_peek(ps, 0)))
+        ps->p++;
+      dims = (DemStr){dim, (size_t)(ps->p - dim)};
+    }
+    DemType elem;
+    if (!dem_eat(ps, '_') || dem_type(ps, &elem))
+      return 1;
+    DemStr post = DEM_CAT(ps, DEM_LIT("["), dims, DEM_LIT("]"), elem.post);
+    out->pre = elem.needs_paren ? elem.pre
+                                : DEM_CAT(ps, elem.pre, DEM_LIT(" "));
+    out->post = post;
+    out->needs_paren = true;
+    break;
+  }
+
+  case 'M': {
+    ps->p++;
+    DemType cls, mem;
+    if (dem_type(ps, &cls) || dem_type(ps, &mem))
+      return 1;
+    DemStr cs = dem_typeStr(ps, &cls);
+    if (mem.needs_paren)
+      *out = dem_declarator(ps, mem, DEM_CAT(ps, cs, DEM_LIT("::*")), true);
+    else
+      *out = dem_declarator(ps, mem,
+                            DEM_CAT(ps, DEM_LIT(" "), cs, DEM_LIT("::*")),
+                            true);
+    break;
+  }
+
+  case 'T': {
+    size_t idx;
+    if (dem_templateParam(ps, out, &idx))
+      return 1;
+    if (dem_peek(ps, 0) != 'I') {
+      // like c++filt, substitutions of it see the template parameters of
+      // where they are used, not of where they were added
+      DemType sub = *out;
+      sub.tparam = idx + 1;
+      return dem_pushSub(ps, sub);
+    }
+    // template template parameter with arguments
+    DemStr args;
+    if (dem_pushSub(ps, *out) || dem_templateArgs(ps, &args, false))
+      return 1;
+    *out = dem_plain(dem_withArgs(ps, dem_typeStr(ps, out), args));
+    break;
+  }
+
+  case 'S': {
+    if (dem_peek(ps, 1) == 't') {
+      DemName n;
+      if (dem_name(ps, &n, false))
+        return 1;
+      *out = dem_plain(n.str);
+      break;
+    }
+    if (dem_substitution(ps, out))
+      return 1;
+    if (dem_peek(ps, 0) != 'I')
+      return 0; // already a candidate
+    DemStr args;
+    if (dem_templateArgs(ps, &args, false))
+      return 1;
+    *out = dem_plain(dem_withArgs(ps, dem_typeStr(ps, out), args));
+    break;
+  }
+
+  case 'N': {
+    // template heavy code repeats the same long class names over and over
+    char const *start = ps->p;
+    if (!dem_fragLookup(ps, out)) {
+      if (ps->oom)
+        return 1;
+      size_t nsubs0 = ps->d->subs_len;
+      DemName n;
+      if (dem_nestedName(ps, &n, false))
+        return 1;
+      *out = dem_plain(n.str);
+      dem_fragStore(ps, start, nsubs0, out);
+    }
+    break;
+  }
+
+  case 'Z': {
+    DemName n;
+    if (dem_localName(ps, &n, false))
+      return 1;
+    *out = dem_plain(n.str);
+    break;
+  }
+
+  case 'D': {
+    char k = dem_peek(ps, 1);
+    char const *bd = k ? dem_builtinD(k) : NULL;
+    if (bd) {
+      ps->p += 2;
+      *out = dem_plain(dem_str(bd));
+      return 0;
+    }
+    if (k == 'F') {
+      ps->p += 2;
+      char const *bits = ps->p;
+      while (isdigit((unsigned char)dem_peek(ps, 0)))
+        ps->p++;
+      DemStr bs = {bits, (size_t)(ps->p - bits)};
+      if (!bs.len || !dem_eat(ps, '_'))
+        return 1;
+      *out = dem_plain(DEM_CAT(ps, DEM_LIT("_Float"), bs));
+      return 0;
+    }
+    if (k == 'v') {
+      // Dv <number> _ <element type>, printed like c++filt
+      ps->p += 2;
+      char const *num = ps->p;
+      while (isdigit((unsigned char)dem_peek(ps, 0)))
+        ps->p++;
+      DemStr ns = {num, (size_t)(ps->p - num)};
+      DemType elem;
+      if (!ns.len || !dem_eat(ps, '_') || dem_type(ps, &elem))
+        return 1;
+      *out = dem_plain(DEM_CAT(ps, dem_typeStr(ps, &elem),
+                               DEM_LIT(" __vector("), ns, DEM_LIT(")")));
+      break;
+    }
+    if (k == 'p') {
+      // pack expansion: the pattern is parsed once for every pack element
+      ps->p += 2;
+      char const *pattern = ps->p;
+      size_t nsubs0 = ps->d->subs_len;
+      long saved_index = ps->pack_index, saved_len = ps->pack_len;
+      ps->pack_index = 0;
+      ps->pack_len = -1;
+
+      DemType inner;
+      if (dem_type(ps, &inner))
+        return 1;
+      DemStr s = dem_typeStr(ps, &inner);
+      if (ps->pack_len < 0) {
+        s = DEM_CAT(ps, s, DEM_LIT("..."));
+      } else if (ps->pack_len == 0) {
+        s = DEM_LIT("");
+      } else {
+        for (long i = 1; i < ps->pack_len; i++) {
+          ps->p = pattern;
+          ps->d->subs_len = nsubs0;
+          ps->pack_index = i;
+          if (dem_type(ps, &inner))
+            return 1;
+          s = DEM_CAT(ps, s, DEM_LIT(", "), dem_typeStr(ps, &inner));
+        }
+      }
+
+      ps->pack_index = saved_index;
+      ps->pack_len = saved_len;
+      *out = dem_plain(s);
+      break;
+    }
+    if (k == 'o') {
+      ps->p += 2;
+      if (dem_functionType(ps, out, true))
+        return 1;
+      break;
+    }
+    return 1;
+  }
+
+  default: {
+    if (!isdigit((unsigned char)c) && c != 'U')
+      return 1;
+    DemName n;
+    if (dem_name(ps, &n, false))
+      return 1;
+    *out = dem_plain(n.str);
+    break;
+  }
+  }
+
+  return dem_pushSub(ps, *out);
+}
+
+static int dem_type(DemParse *ps, DemType *out) {
+  if (++ps->depth > DEM_MAX_DEPTH)
+    return 1;
+  int r = dem_type_(ps, out);
+  ps->depth--;
+  return r;
+}
+
+/** h <number> _ | v <number> _ <number> _ */
+static int dem_callOffset(DemParse *ps) {
+  if (dem_eat(ps, 'h'))
+    return dem_snumber(ps) || !dem_eat(ps, '_');
+  if (dem_eat(ps, 'v'))
+    return dem_snumber(ps) || !dem_eat(ps, '_') || dem_snumber(ps) ||
+           !dem_eat(ps, '_');
+  return 1;
+}
+
+static int dem_specialName(DemParse *ps, DemStr *out) {
+  static struct {
+    char code[3];
+    char const *prefix;
+  } const typeSpecials[] = {
+      {"TV", "vtable for "},
+      {"TT", "VTT for "},
+      {"TI", "typeinfo for "},
+      {"TS", "typeinfo name for "},
+  };
+  for (size_t i = 0; i < sizeof(typeSpecials) / sizeof(typeSpecials[0]);
+       i++) {
+    if (dem_eat2(ps, typeSpecials[i].code)) {
+      DemType t;
+      if (dem_type(ps, &t))
+        return 1;
+      *out = DEM_CAT(ps, dem_str(typeSpecials[i].prefix), dem_typeStr(ps, &t));
+      return 0;
+    }
+  }
+
+  DemStr prefix;
+  DemName n;
+  DemStr enc;
+
+  if (dem_eat2(ps, "TH") || dem_eat2(ps, "TW")) {
+    prefix = ps->p[-1] == 'H' ? DEM_LIT("TLS init function for ")
+                              : DEM_LIT("TLS wrapper function for ");
+    if (dem_name(ps, &n, false))
+      return 1;
+    *out = DEM_CAT(ps, prefix, n.str);
+    return 0;
+  }
+
+  if (dem_eat2(ps, "GV")) {
+    if (dem_name(ps, &n, false))
+      return 1;
+    *out = DEM_CAT(ps, DEM_LIT("guard variable for "), n.str);
+    return 0;
+  }
+
+  if (dem_eat2(ps, "GR")) {
+    size_t seq;
+    if (dem_name(ps, &n, false) || dem_seqId(ps, &seq))
+      return 1;
+    char num[24];
+    sprintf(num, "%zu", seq);
+    *out = DEM_CAT(ps, DEM_LIT("reference temporary #"), dem_str(num),
+                   DEM_LIT(" for "), n.str);
+    return 0;
+  }
+
+  if (dem_eat2(ps, "TC")) {
+    DemType derived, base;
+    if (dem_type(ps, &derived) || dem_snumber(ps) || !dem_eat(ps, '_') ||
+        dem_type(ps, &base))
+      return 1;
+    *out = DEM_CAT(ps, DEM_LIT("construction vtable for "),
+                   dem_typeStr(ps, &base), DEM_LIT("-in-"),
+                   dem_typeStr(ps, &derived));
+    return 0;
+  }
+
+  if (dem_eat2(ps, "Tc")) {
+    if (dem_callOffset(ps) || dem_callOffset(ps))
+      return 1;
+    prefix = DEM_LIT("covariant return thunk to ");
+  } else if (dem_eat(ps, 'T')) {
+    bool virt = dem_peek(ps, 0) == 'v';
+    if (dem_callOffset(ps))
+      return 1;
+    prefix = virt ? DEM_LIT("virtual thunk to ")
+                  : DEM_LIT("non-virtual thunk to ");
+  } else if (dem_eat2(ps, "GA")) {
+    prefix = DEM_LIT("hidden alias for ");
+  } else if (dem_eat2(ps, "GT")) {
+    if (!dem_eat(ps, 't') && !dem_eat(ps, 'n'))
+      return 1;
+    prefix = DEM_LIT("transaction clone for ");
+  } else {
+    return 1;
+  }
+
+  if (dem_encoding(ps, &enc, true))
+    return 1;
+  *out = DEM_CAT(ps, prefix, enc);
+  return 0;
+}
+
+static int dem_encoding(DemParse *ps, DemStr *out, bool top) {
+  if (++ps->depth > DEM_MAX_DEPTH)
+    return 1;
+
+  char c = dem_peek(ps, 0);
+  if (c == 'T' || c == 'G') {
+    int r = dem_specialName(ps, out);
+    ps->depth--;
+    return r;
+  }
+
+  DemName n;
+  if (dem_name(ps, &n, true))
+    return 1;
+
+  c = dem_peek(ps, 0);
+  if (c == '\0' || c == 'E') {
+    // data object
+    *out = DEM_CAT(ps, n.str, n.quals);
+    ps->depth--;
+    return 0;
+  }
+  // like c++filt, only functions have clone suffixes
+  if (c == '.')
+    return 1;
+
+  DemStr ret = DEM_LIT("");
+  if (n.templ && !n.no_ret) {
+    DemType r;
+    if (dem_type(ps, &r))
+      return 1;
+    if (top)
+      ret = DEM_CAT(ps, dem_typeStr(ps, &r), DEM_LIT(" "));
+  }
+
+  DemStr params;
+  if (dem_params(ps, &params, false))
+    return 1;
+
+  *out = DEM_CAT(ps, ret, n.str, params, n.quals);
+  ps->depth--;
+  return 0;
+}
+
+/** compiler generated clones: .constprop.0, .isra.1, .cold, ... */
+static int dem_cloneSuffixes(DemParse *ps, DemStr *out) {
+  while (dem_peek(ps, 0) == '.') {
+    char const *start = ps->p;
+    ps->p++;
+    char const *word = ps->p;
+    while (isalpha((unsigned char)dem_peek(ps, 0)) || dem_peek(ps, 0) == '_')
+      ps->p++;
+    if (ps->p == word) {
+      if (!isdigit((unsigned char)dem_peek(ps, 0)))
+        return 1;
+      while (isdigit((unsigned char)dem_peek(ps, 0)))
+        ps->p++;
+    }
+    while (dem_peek(ps, 0) == '.' && isdigit((unsigned char)dem_peek(ps, 1))) {
+      ps->p++;
+      while (isdigit((unsigned char)dem_peek(ps, 0)))
+        ps->p++;
+    }
+    DemStr clone = {start, (size_t)(ps->p - start)};
+    *out = DEM_CAT(ps, *out, DEM_LIT(" [clone "), clone, DEM_LIT("]"));
+  }
+  return 0;
+}
+
+static DemNameEnt *Demangler_findName(Demangler *d, char const *mangled,
+                                      size_t len, uint64_t h) {
+  if (!d->names_cap)
+    return NULL;
+  for (size_t i = h & (d->names_cap - 1);; i = (i + 1) & (d->names_cap - 1)) {
+    DemNameEnt *e = &d->names[i];
+    if (!e->mangled)
+      return NULL;
+    if (e->hash == h && e->mangled_len == len &&
+        !memcmp(e->mangled, mangled, len))
+      return e;
+  }
+}
+
+static void Demangler_storeName(Demangler *d, char const *mangled, size_t len,
+                                uint64_t h, DemStr const *demangled) {
+  if ((d->names_len + 1) * 2 > d->names_cap) {
+    size_t ncap = d->names_cap ? d->names_cap * 2 : 1024;
+    DemNameEnt *n = calloc(ncap, sizeof(DemNameEnt));
+    if (!n)
+      return;
+    for (size_t i = 0; i < d->names_cap; i++) {
+      DemNameEnt *e = &d->names[i];
+      if (!e->mangled)
+        continue;
+      size_t j = e->hash & (ncap - 1);
+      while (n[j].mangled)
+        j = (j + 1) & (ncap - 1);
+      n[j] = *e;
+    }
+    free(d->names);
+    d->names = n;
+    d->names_cap = ncap;
+  }
+
+  bool oom = false;
+  DemStr m = dem_dup(&d->arena, (DemStr){mangled, len}, &oom);
+  DemStr r = {NULL, 0};
+  if (demangled)
+    r = dem_dup(&d->arena, *demangled, &oom);
+  if (oom)
+    return;
+
+  size_t j = h & (d->names_cap - 1);
+  while (d->names[j].mangled)
+    j = (j + 1) & (d->names_cap - 1);
+  d->names[j] = (DemNameEnt){
+      .hash = h,
+      .mangled = m.str,
+      .mangled_len = len,
+      .demangled = r.str,
+  };
+  d->names_len++;
+}
+
+char const *Demangler_demangle(Demangler *d, char const *mangled) {
+  size_t len = strlen(mangled);
+  // some targets prefix all C symbols with an underscore
+  if (len > 3 && !memcmp(mangled, "__Z", 3)) {
+    mangled++;
+    len--;
+  }
+  if (len < 3 || mangled[0] != '_' || mangled[1] != 'Z')
+    return NULL;
+
+  if (d->arena.size > DEM_ARENA_LIMIT)
+    Demangler_flush(d);
+
+  uint64_t h = hash((unsigned char const *)mangled, (int)len);
+  DemNameEnt *cached = Demangler_findName(d, mangled, len, h);
+  if (cached)
+    return cached->demangled;
+
+  DemArena_reset(&d->scratch);
+  d->subs_len = 0;
+  d->tparams_len = 0;
+  d->args_len = 0;
+
+  DemParse ps = {
+      .d = d,
+      .p = mangled + 2,
+      .end = mangled + len,
+      .pack_index = -1,
+      .pack_len = -1,
+  };
+
+  DemStr res;
+  int err = dem_encoding(&ps, &res, true);
+  if (!err)
+    err = dem_cloneSuffixes(&ps, &res);
+  if (!err && ps.p != ps.end)
+    err = 1;
+  if (ps.oom)
+    return NULL;
+
+  Demangler_storeName(d, mangled, len, h, err ? NULL : &res);
+  cached = Demangler_findName(d, mangled, len, h);
+  if (cached)
+    return cached->demangled;
+
+  // could not be cached
+  if (err)
+    return NULL;
+  res = DEM_CAT(&ps, res);
+  return ps.oom ? NULL : res.str;
+}
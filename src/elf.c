@@ -167,6 +167,27 @@ int Elf_getStrTable(char **heapDest, size_t *sizeDest, size_t id,
 int Elf_getSymTable(Elf64_Sym **heapDest, size_t *sizeDest,
                     Elf_Header const *elf, Elf64_SectionHeader const *section,
                     FILE *file, void (*err)(const char *)) {
+  return Elf_getSymTableFrom(heapDest, sizeDest, 0, elf, section, file, err);
+}
+
+int Elf_getSymTableFrom(Elf64_Sym **heapDest, size_t *sizeDest, size_t first,
+                        Elf_Header const *elf,
+                        Elf64_SectionHeader const *symtab, FILE *file,
+                        void (*err)(const char *)) {
+  size_t entsize = elf->begin.clazz == ELFCLASS_32 ? sizeof(Elf32_Sym)
+                                                   : sizeof(Elf64_Sym);
+
+  // only read (and byte swap) the requested tail of the table
+  Elf64_SectionHeader part = *symtab;
+  if (first * entsize >= part.sh_size) {
+    *heapDest = NULL;
+    *sizeDest = 0;
+    return 0;
+  }
+  part.sh_offset += first * entsize;
+  part.sh_size -= first * entsize;
+  Elf64_SectionHeader const *section = &part;
+
   if (elf->begin.clazz == ELFCLASS_32) {
     Elf32_Sym *h0;
     size_t h0uz;
@@ -0,0 +1,111 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
+#include "ubu/filecopy.h"
+
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <io.h>
+#elif !defined(__linux__)
+#include <unistd.h>
+#endif
+
+#define COPY_BUF_SIZE (64 * 1024)
+
+#ifdef __linux__
+/** returns how much was copied; stops early if the kernel can not do it */
+static uint64_t copyKernel(int ofd, uint64_t outOff, int ifd, uint64_t inOff,
+                           uint64_t len) {
+  uint64_t done = 0;
+
+  // the kernel does not copy overlapping ranges of one file in a defined order
+  if (ifd == ofd && inOff < outOff + len && outOff < inOff + len)
+    return 0;
+
+  loff_t io = inOff, oo = outOff;
+  while (done < len) {
+    ssize_t n = copy_file_range(ifd, &io, ofd, &oo, len - done, 0);
+    if (n <= 0)
+      break;
+    done += n;
+  }
+
+  // sendfile writes at the current position of the output
+  if (done < len && lseek(ofd, outOff + done, SEEK_SET) != -1) {
+    off_t so = inOff + done;
+    while (done < len) {
+      ssize_t n = sendfile(ofd, ifd, &so, len - done);
+      if (n <= 0)
+        break;
+      done += n;
+    }
+  }
+
+  return done;
+}
+#endif
+
+int File_copyRange(FILE *out, uint64_t outOff, FILE *in, uint64_t inOff,
+                   uint64_t len) {
+  if (fflush(out))
+    return 1;
+
+#ifdef __linux__
+  uint64_t done = copyKernel(fileno(out), outOff, fileno(in), inOff, len);
+  outOff += done;
+  inOff += done;
+  len -= done;
+  if (!len)
+    return 0;
+#endif
+
+  // seeks for every chunk, so [in] and [out] can be the same FILE;
+  // that is fine as long as [outOff] is not after [inOff]
+  char buf[COPY_BUF_SIZE];
+  while (len) {
+    size_t chunk = len < COPY_BUF_SIZE ? len : COPY_BUF_SIZE;
+    if (fseeko(in, (off_t)inOff, SEEK_SET) ||
+        fread(buf, 1, chunk, in) != chunk)
+      return 1;
+    if (fseeko(out, (off_t)outOff, SEEK_SET) ||
+        fwrite(buf, 1, chunk, out) != chunk)
+      return 1;
+    inOff += chunk;
+    outOff += chunk;
+    len -= chunk;
+  }
+  return 0;
+}
+
+int File_copyRangeMapped(FILE *out, uint64_t outOff, FILE *in, void const *src,
+                         uint64_t inOff, uint64_t len) {
+  if (fflush(out))
+    return 1;
+
+#ifdef __linux__
+  uint64_t done = copyKernel(fileno(out), outOff, fileno(in), inOff, len);
+  outOff += done;
+  inOff += done;
+  len -= done;
+  if (!len)
+    return 0;
+#endif
+
+  if (fseeko(out, (off_t)outOff, SEEK_SET))
+    return 1;
+  return fwrite((char const *)src + inOff, 1, len, out) != len;
+}
+
+int File_presize(FILE *out, uint64_t size) {
+  if (fflush(out))
+    return 1;
+#ifdef _WIN32
+  return _chsize_s(_fileno(out), size) != 0;
+#else
+  return ftruncate(fileno(out), size) != 0;
+#endif
+}
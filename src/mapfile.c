@@ -0,0 +1,60 @@
+#include "ubu/mapfile.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static int readWhole(MappedFile *dest, FILE *file) {
+  if (fseeko(file, 0, SEEK_END))
+    return 1;
+  off_t size = ftello(file);
+  if (size < 0 || (uint64_t)size > SIZE_MAX)
+    return 1;
+  rewind(file);
+
+  void *buf = malloc(size ? size : 1);
+  if (!buf)
+    return 1;
+  if (fread(buf, 1, size, file) != (size_t)size) {
+    free(buf);
+    return 1;
+  }
+
+  dest->data = buf;
+  dest->size = size;
+  dest->_mapped = false;
+  return 0;
+}
+
+int MappedFile_open(MappedFile *dest, FILE *file) {
+#ifndef _WIN32
+  struct stat st;
+  int fd = fileno(file);
+  if (fd != -1 && !fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0 &&
+      (uint64_t)st.st_size <= SIZE_MAX) {
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      dest->data = p;
+      dest->size = st.st_size;
+      dest->_mapped = true;
+      return 0;
+    }
+  }
+#endif
+
+  return readWhole(dest, file);
+}
+
+void MappedFile_close(MappedFile *m) {
+#ifndef _WIN32
+  if (m->_mapped) {
+    munmap((void *)m->data, m->size);
+    return;
+  }
+#endif
+  free((void *)m->data);
+}
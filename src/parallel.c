@@ -0,0 +1,70 @@
+#include "ubu/parallel.h"
+
+#ifdef _WIN32
+
+// no thread pool on windows yet, everything runs on the calling thread
+
+void Parallel_for(size_t count, unsigned threads, void (*fn)(void *, size_t),
+                  void *ctx) {
+  (void)threads;
+  for (size_t i = 0; i < count; i++)
+    fn(ctx, i);
+}
+
+unsigned Parallel_numCpus(void) { return 1; }
+
+#else
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+typedef struct {
+  size_t count;
+  void (*fn)(void *ctx, size_t i);
+  void *ctx;
+  atomic_size_t next;
+} Job;
+
+static void *worker(void *arg) {
+  Job *job = arg;
+  size_t i;
+  while ((i = atomic_fetch_add(&job->next, 1)) < job->count)
+    job->fn(job->ctx, i);
+  return NULL;
+}
+
+void Parallel_for(size_t count, unsigned threads, void (*fn)(void *, size_t),
+                  void *ctx) {
+  if (!threads)
+    threads = Parallel_numCpus();
+  if (threads > count)
+    threads = count;
+
+  Job job = {.count = count, .fn = fn, .ctx = ctx};
+  atomic_init(&job.next, 0);
+
+  if (threads <= 1) {
+    worker(&job);
+    return;
+  }
+
+  pthread_t tids[threads - 1];
+  unsigned started = 0;
+  for (; started < threads - 1; started++)
+    // if a thread can not be created, the others just do more of the work
+    if (pthread_create(&tids[started], NULL, worker, &job))
+      break;
+
+  worker(&job);
+
+  for (unsigned i = 0; i < started; i++)
+    pthread_join(tids[i], NULL);
+}
+
+unsigned Parallel_numCpus(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (unsigned)n : 1;
+}
+
+#endif
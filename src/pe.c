@@ -2,19 +2,6 @@
 #include "ubu/utils.h"
 #include <stdbool.h>
 
-void ToPeSection(PeSection *dst, CoffSection const *src) {
-  memcpy(dst->name, src->name, 8);
-  dst->virtualSize = (uint32_t)src->virtualSize;
-  dst->virtualAddress = (uint32_t)src->virtualAddress;
-  dst->dataUz = (uint32_t)src->dataUz;
-  dst->fileDataOffset = (uint32_t)src->fileDataOffset;
-  dst->fileRelocsOffset = (uint32_t)src->fileRelocsOffset;
-  dst->fileLinenumsOffset = (uint32_t)src->fileLinenumsOffset;
-  dst->numRelocs = (uint16_t)src->numRelocs;
-  dst->numLinenums = (uint16_t)src->numLinenums;
-  dst->characteristics = (CoffSectionCharacteristics)src->characteristics;
-}
-
 const char *CoffSym_name(CoffSym const *sym, OpPe *pe) {
   if (sym->name[0] == 0) {
     uint32_t strtabidx = *(uint32_t *)(&sym->name[4]);
@@ -26,6 +13,43 @@ const char *CoffSym_name(CoffSym const *sym, OpPe *pe) {
   }
 }
 
+int CoffImport_parse(CoffImport *out, void const *data, size_t size) {
+  CoffImportHeader hd;
+  if (size < sizeof(hd))
+    return 1;
+  memcpy(&hd, data, sizeof(hd));
+  if (is_bigendian()) {
+    endianess_swap(hd.sig1);
+    endianess_swap(hd.sig2);
+    endianess_swap(hd.version);
+    endianess_swap(hd.machine);
+    endianess_swap(hd.sizeOfData);
+    endianess_swap(hd.ordinalOrHint);
+    endianess_swap(hd.typeInfo);
+  }
+  // anonymous (e.g. bigobj) objects share the signature, but not version 0
+  if (hd.sig1 != 0 || hd.sig2 != 0xFFFF || hd.version != 0 ||
+      hd.sizeOfData > size - sizeof(hd))
+    return 1;
+
+  // both names have to be terminated inside the data
+  char const *names = (char const *)data + sizeof(hd);
+  size_t symLen = strnlen(names, hd.sizeOfData);
+  if (symLen == hd.sizeOfData)
+    return 1;
+  size_t rest = hd.sizeOfData - symLen - 1;
+  if (strnlen(names + symLen + 1, rest) == rest)
+    return 1;
+
+  out->type = (CoffImportType)(hd.typeInfo & 0x3);
+  out->nameType = (CoffImportNameType)((hd.typeInfo >> 2) & 0x7);
+  out->machine = hd.machine;
+  out->ordinalOrHint = hd.ordinalOrHint;
+  out->symbol = names;
+  out->dll = names + symLen + 1;
+  return 0;
+}
+
 void OpPe_rewindToSyms(OpPe *pe) {
   fseek(pe->file, pe->header.fileOffToCoffSymTable, SEEK_SET);
 }
@@ -72,10 +96,8 @@ int OpPe_open(OpPe *dest, FILE *file) {
 
     char sig[4] = {0};
     fread(sig, 4, 1, file);
-    if (memcmp(sig, "PE\0", 4)) {
-      puts(sig);
+    if (memcmp(sig, "PE\0", 4))
       return 1;
-    }
   }
 
   fread(&dest->header, sizeof(CoffHeader), 1, file);
@@ -90,10 +112,10 @@ int OpPe_open(OpPe *dest, FILE *file) {
     endianess_swap(dest->header.characteristics);
   }
 
-  // skip opt header
-  fseek(file, dest->header.optHeaderSize + (isCoff ? 2 : 0), SEEK_CUR);
+  // skip opt header; objects have the same 40 byte section headers as images
+  fseek(file, dest->header.optHeaderSize, SEEK_CUR);
 
-  size_t sectionSize = isCoff ? sizeof(CoffSection) : sizeof(PeSection);
+  size_t sectionSize = sizeof(PeSection);
 
   dest->sections = malloc(dest->header.numSections * sectionSize);
   if (!dest->sections) {
@@ -104,29 +126,16 @@ int OpPe_open(OpPe *dest, FILE *file) {
 
   if (is_bigendian()) {
     for (size_t i = 0; i < dest->header.numSections; i++) {
-      if (isCoff) {
-        CoffSection *s = &((CoffSection *)dest->sections)[i];
-        endianess_swap(s->virtualSize);
-        endianess_swap(s->virtualAddress);
-        endianess_swap(s->dataUz);
-        endianess_swap(s->fileDataOffset);
-        endianess_swap(s->fileRelocsOffset);
-        endianess_swap(s->fileLinenumsOffset);
-        endianess_swap(s->numRelocs);
-        endianess_swap(s->numLinenums);
-        endianess_swap(s->characteristics);
-      } else {
-        PeSection *s = &((PeSection *)dest->sections)[i];
-        endianess_swap(s->virtualSize);
-        endianess_swap(s->virtualAddress);
-        endianess_swap(s->dataUz);
-        endianess_swap(s->fileDataOffset);
-        endianess_swap(s->fileRelocsOffset);
-        endianess_swap(s->fileLinenumsOffset);
-        endianess_swap(s->numRelocs);
-        endianess_swap(s->numLinenums);
-        endianess_swap(s->characteristics);
-      }
+      PeSection *s = &((PeSection *)dest->sections)[i];
+      endianess_swap(s->virtualSize);
+      endianess_swap(s->virtualAddress);
+      endianess_swap(s->dataUz);
+      endianess_swap(s->fileDataOffset);
+      endianess_swap(s->fileRelocsOffset);
+      endianess_swap(s->fileLinenumsOffset);
+      endianess_swap(s->numRelocs);
+      endianess_swap(s->numLinenums);
+      endianess_swap(s->characteristics);
     }
   }
 
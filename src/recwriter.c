@@ -0,0 +1,158 @@
+#include "ubu/recwriter.h"
+#include <string.h>
+
+// nothing in here allocates; everything goes straight into the FILE buffer
+
+static void putLe(FILE *out, uint64_t v, int bytes) {
+  for (int i = 0; i < bytes; i++)
+    fputc((int)((v >> (8 * i)) & 0xFF), out);
+}
+
+static void putPad(FILE *out, size_t len) {
+  for (size_t i = len; i % 8; i++)
+    fputc(0, out);
+}
+
+/** size is rounded up to a multiple of 8 */
+static void binRecord(RecWriter *w, RecType type, size_t payload) {
+  size_t size = 8 + payload;
+  size = (size + 7) & ~(size_t)7;
+  putLe(w->out, size, 4);
+  putLe(w->out, type, 4);
+}
+
+static void jsonStr(FILE *out, char const *s) {
+  fputc('"', out);
+  for (; *s; s++) {
+    unsigned char c = *s;
+    if (c == '"' || c == '\\') {
+      fputc('\\', out);
+      fputc(c, out);
+    } else if (c < 0x20) {
+      fprintf(out, "\\u%04x", c);
+    } else {
+      fputc(c, out);
+    }
+  }
+  fputc('"', out);
+}
+
+static void jsonEndFile(RecWriter *w) {
+  if (!w->_inFile)
+    return;
+  if (w->_hasSyms)
+    fputs("\n]", w->out);
+  fputc('}', w->out);
+  w->_inFile = false;
+}
+
+void RecWriter_begin(RecWriter *w, FILE *out, RecFormat format,
+                     char const *tool) {
+  memset(w, 0, sizeof(RecWriter));
+  w->out = out;
+  w->format = format;
+
+  if (format == RecFormat_JSON) {
+    fputs("{\"tool\":", out);
+    jsonStr(out, tool);
+    fputs(",\"files\":[", out);
+  } else {
+    char hd[12] = REC_MAGIC;
+    fwrite(hd, 1, 8, out);
+    putLe(out, REC_VERSION, 4);
+    memset(hd, 0, 4);
+    memcpy(hd, tool, strnlen(tool, 4));
+    fwrite(hd, 1, 4, out);
+  }
+}
+
+void RecWriter_file(RecWriter *w, char const *path, char const *member) {
+  if (w->format == RecFormat_JSON) {
+    jsonEndFile(w);
+    if (w->_count++)
+      fputc(',', w->out);
+    fputs("\n{\"file\":", w->out);
+    jsonStr(w->out, path);
+    if (member) {
+      fputs(",\"member\":", w->out);
+      jsonStr(w->out, member);
+    }
+    w->_inFile = true;
+    w->_hasSyms = false;
+    return;
+  }
+
+  size_t pathLen = strlen(path);
+  size_t memberLen = member ? strlen(member) : 0;
+  binRecord(w, RecType_FILE, 8 + pathLen + 1 + memberLen + 1);
+  putLe(w->out, pathLen, 4);
+  putLe(w->out, memberLen, 4);
+  fwrite(path, 1, pathLen + 1, w->out);
+  if (member)
+    fwrite(member, 1, memberLen + 1, w->out);
+  else
+    fputc(0, w->out);
+  putPad(w->out, pathLen + 1 + memberLen + 1);
+}
+
+void RecWriter_sym(RecWriter *w, char const *name, char type, uint64_t value,
+                   bool hasValue) {
+  if (w->format == RecFormat_JSON) {
+    fputs(w->_hasSyms ? ",\n" : ",\"symbols\":[\n", w->out);
+    w->_hasSyms = true;
+    fputs("{\"name\":", w->out);
+    jsonStr(w->out, name);
+    fprintf(w->out, ",\"type\":\"%c\"", type);
+    if (hasValue)
+      fprintf(w->out, ",\"value\":%llu", (unsigned long long)value);
+    fputc('}', w->out);
+    return;
+  }
+
+  size_t nameLen = strlen(name);
+  binRecord(w, RecType_SYM, 16 + nameLen + 1);
+  putLe(w->out, value, 8);
+  fputc(type, w->out);
+  fputc(hasValue ? RecSymFlag_HAS_VALUE : 0, w->out);
+  putLe(w->out, 0, 2);
+  putLe(w->out, nameLen, 4);
+  fwrite(name, 1, nameLen + 1, w->out);
+  putPad(w->out, nameLen + 1);
+}
+
+void RecWriter_size(RecWriter *w, uint64_t text, uint64_t data,
+                    uint64_t bss) {
+  uint64_t total = text + data + bss;
+  if (w->format == RecFormat_JSON) {
+    fprintf(w->out, ",\"text\":%llu,\"data\":%llu,\"bss\":%llu,\"total\":%llu",
+            (unsigned long long)text, (unsigned long long)data,
+            (unsigned long long)bss, (unsigned long long)total);
+    return;
+  }
+
+  binRecord(w, RecType_SIZE, 32);
+  putLe(w->out, text, 8);
+  putLe(w->out, data, 8);
+  putLe(w->out, bss, 8);
+  putLe(w->out, total, 8);
+}
+
+void RecWriter_end(RecWriter *w) {
+  if (w->format == RecFormat_JSON) {
+    jsonEndFile(w);
+    fputs("\n]}\n", w->out);
+  } else {
+    binRecord(w, RecType_END, 0);
+  }
+  fflush(w->out);
+}
+
+int RecFormat_parse(RecFormat *dest, char const *str) {
+  if (!strcmp(str, "json"))
+    *dest = RecFormat_JSON;
+  else if (!strcmp(str, "binary"))
+    *dest = RecFormat_BINARY;
+  else
+    return 1;
+  return 0;
+}
@@ -1,5 +1,7 @@
 #include "ubu/utils.h"
 #include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
 
 void memrevcpy(void *dest, void const *src, size_t bytes) {
   if (bytes == 0)
@@ -22,6 +24,49 @@ int strieq(char const *a, char const *b) {
   return *a == *b;
 }
 
+static uint64_t slotHash(void const *slot) {
+  uint64_t h;
+  memcpy(&h, slot, sizeof(h));
+  return h;
+}
+
+void *HashSlots_find(HashSlots const *t, void *slots, size_t cap,
+                     void const *key, uint64_t h) {
+  size_t i = h & (cap - 1);
+  for (;;) {
+    void *slot = (char *)slots + i * t->slot_size;
+    if (!t->used(slot) || (slotHash(slot) == h && t->holds(slot, key)))
+      return slot;
+    i = (i + 1) & (cap - 1);
+  }
+}
+
+void *HashSlots_reserve(HashSlots const *t, void *slots, size_t *cap,
+                        size_t count) {
+  size_t ncap = slots && *cap ? *cap : 64;
+  while (ncap * 3 < count * 4)
+    ncap *= 2;
+  if (slots && ncap == *cap)
+    return slots;
+
+  char *n = calloc(ncap, t->slot_size);
+  if (!n)
+    return NULL;
+  // the keys are unique already, so only an empty slot has to be found
+  for (size_t i = 0; slots && i < *cap; i++) {
+    char const *slot = (char const *)slots + i * t->slot_size;
+    if (!t->used(slot))
+      continue;
+    size_t j = slotHash(slot) & (ncap - 1);
+    while (t->used(n + j * t->slot_size))
+      j = (j + 1) & (ncap - 1);
+    memcpy(n + j * t->slot_size, slot, t->slot_size);
+  }
+  free(slots);
+  *cap = ncap;
+  return n;
+}
+
 #define FNV1A(type, prime, offset, dest, value, valueSize)                     \
   {                                                                            \
     type hash = offset;                                                        \
@@ -38,3 +83,23 @@ uint64_t hash(const unsigned char *data, int len) {
   FNV1A(uint64_t, 0x100000001B3, 0xcbf29ce484222325, &res, data, len);
   return res;
 }
+
+ObjFmt ObjFmt_detect(unsigned char const *m, size_t len) {
+  if (len >= 4 && !memcmp(m, "\177ELF", 4))
+    return ObjFmt_ELF;
+  // chunk file magic in either byte order
+  if (len >= 4 && (!memcmp(m, "\xC5\xC6\xCB\xC3", 4) ||
+                   !memcmp(m, "\xC3\xCB\xC6\xC5", 4)))
+    return ObjFmt_AOF;
+  // IMAGE_FILE_MACHINE_UNKNOWN, then 0xFFFF
+  if (len >= 4 && !memcmp(m, "\0\0\xFF\xFF", 4))
+    return ObjFmt_COFF_IMPORT;
+  if (len >= 2 && m[0] == 'M' && m[1] == 'Z')
+    return ObjFmt_PE;
+  // same machines as OpPe_open accepts for plain COFF
+  if (len >= 2 && ((m[0] == 0x4C && m[1] == 0x01) ||
+                   (m[0] == 0x64 && m[1] == 0x86) ||
+                   (m[0] == 0x00 && m[1] == 0x02)))
+    return ObjFmt_PE;
+  return ObjFmt_UNKNOWN;
+}
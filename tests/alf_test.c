@@ -0,0 +1,109 @@
+#include "ubu/alf.h"
+#include "chunkwriter.h"
+
+/** LIB_DIRY and OFL_SYMT entry: chunk index, entry length, data length, data */
+static void putEntry(Buf* b, uint32_t chunk, char const* name, bool stamp)
+{
+  size_t n = (strlen(name) + 1 + 3) / 4 * 4 + (stamp ? 8 : 0);
+  put32(b, chunk);
+  put32(b, 12 + n);
+  put32(b, n);
+  putStr(b, name);
+  if ( stamp )
+  {
+    put32(b, 0x1234);
+    put32(b, 0x56780000);
+  }
+}
+
+static bool isMember(AlfMember const* m, char const* name)
+{
+  return m->name_len == strlen(name) && !memcmp(m->name, name, m->name_len);
+}
+
+int main(void)
+{
+  // 0 DIRY, 1 TIME, 2 VSRN, 3..5 DATA, 6 SYMT, 7 OTIM
+  Chunk chunks[8] = {
+    { "LIB_DIRY" }, { "LIB_TIME" }, { "LIB_VSRN" },
+    { "LIB_DATA" }, { "LIB_DATA" }, { "LIB_DATA" },
+    { "OFL_SYMT" }, { "OFL_TIME" },
+  };
+  putEntry(&chunks[0].data, 3, "first.o", true);
+  putEntry(&chunks[0].data, 0, "", false); // unused entry
+  putEntry(&chunks[0].data, 5, "last.o", true);
+  putEntry(&chunks[0].data, 4, "middle.o", false);
+  put32(&chunks[1].data, 0x1234);
+  put32(&chunks[1].data, 0x56780000);
+  put32(&chunks[2].data, 1);
+  // the members are never opened, their content does not matter
+  for ( int i = 3; i <= 5; i ++ )
+    put32(&chunks[i].data, i);
+  putEntry(&chunks[6].data, 3, "first_func", false);
+  putEntry(&chunks[6].data, 5, "last_func", false);
+  putEntry(&chunks[6].data, 4, "middle_func", false);
+  putEntry(&chunks[6].data, 5, "first_func", false); // the first definition wins
+  putBytes(&chunks[7].data, chunks[1].data.buf, chunks[1].data.len);
+
+  FILE* f = writeChunks(chunks, 8);
+  Alf alf;
+  check(f && !Alf_open(&alf, f), "open");
+  if ( failed )
+  {
+    freeChunks(chunks, 8);
+    return 1;
+  }
+
+  AlfMember m;
+  check(Alf_hasSymtab(&alf), "up to date symbol table");
+  check(!Alf_lookupSymbol(&alf, "first_func", &m) && isMember(&m, "first.o"), "first definition");
+  check(!Alf_lookupSymbol(&alf, "middle_func", &m) && isMember(&m, "middle.o"), "middle_func");
+  check(!Alf_lookupSymbol(&alf, "last_func", &m) && isMember(&m, "last.o"), "last_func");
+  check(m.chunk_index == 5 && m.size == 4, "member chunk");
+  check(m.time[0] == 0x1234 && m.time[1] == 0x56780000, "member time stamp");
+  check(!Alf_lookupSymbol(&alf, "last_func", NULL), "lookup without member");
+  check(Alf_lookupSymbol(&alf, "missing", &m), "missing symbol");
+  check(Alf_lookupSymbol(&alf, "", &m), "empty name");
+
+  check(!Alf_member(&alf, 4, &m) && isMember(&m, "middle.o"), "member by chunk");
+  check(Alf_member(&alf, 0, &m), "directory chunk is no member");
+  check(Alf_member(&alf, 6, &m), "symbol table chunk is no member");
+  check(Alf_member(&alf, 100, &m), "chunk out of range");
+
+  // looking up members does not disturb an iteration
+  Alf_rewind(&alf);
+  char const* order[] = { "first.o", "last.o", "middle.o" };
+  size_t n = 0;
+  while ( Alf_next(&alf, &m) )
+  {
+    check(n < 3 && isMember(&m, order[n]), "directory order");
+    n ++;
+    AlfMember other;
+    Alf_lookupSymbol(&alf, "middle_func", &other);
+  }
+  check(n == 3, "member count");
+
+  Alf_close(&alf);
+  fclose(f);
+
+  // a symbol table older than the library is not used
+  chunks[7].data.len = 0;
+  put32(&chunks[7].data, 0x1233);
+  put32(&chunks[7].data, 0);
+  f = writeChunks(chunks, 8);
+  check(f && !Alf_open(&alf, f), "open stale");
+  if ( f && !failed )
+  {
+    check(!Alf_hasSymtab(&alf), "stale symbol table");
+    check(Alf_lookupSymbol(&alf, "first_func", &m), "stale lookup");
+    Alf_close(&alf);
+  }
+  if ( f )
+    fclose(f);
+  freeChunks(chunks, 8);
+
+  if ( failed )
+    return 1;
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include "ubu/aof.h"
+#include "chunkwriter.h"
+
+#define NUM_SYMS 300
+
+static char names[NUM_SYMS][16];
+
+int main(void)
+{
+  Chunk chunks[5] = {
+    { "OBJ_HEAD" }, { "OBJ_AREA" }, { "OBJ_IDFN" }, { "OBJ_SYMT" }, { "OBJ_STRT" },
+  };
+
+  // string table: its size, then the names; offsets count the size word
+  Buf strs = {0};
+  uint32_t area_name = 4;
+  putStr(&strs, "C$$code");
+  uint32_t name_offs[NUM_SYMS];
+  for ( int i = 0; i < NUM_SYMS; i ++ )
+  {
+    snprintf(names[i], sizeof(names[i]), "sym%d", i);
+    name_offs[i] = 4 + strs.len;
+    putStr(&strs, names[i]);
+  }
+  put32(&chunks[4].data, 4 + strs.len);
+  putBytes(&chunks[4].data, strs.buf, strs.len);
+  free(strs.buf);
+
+  // one code area; the last symbol is an undefined reference to sym0
+  Buf* hd = &chunks[0].data;
+  put32(hd, 0xC5E2D080);
+  put32(hd, 310);
+  put32(hd, 1);
+  put32(hd, NUM_SYMS + 1);
+  put32(hd, 0);
+  put32(hd, 0);
+  put32(hd, area_name);
+  put32(hd, 0x2 | 0x200);
+  put32(hd, 4 * NUM_SYMS);
+  put32(hd, 0);
+  put32(hd, 0);
+  for ( int i = 0; i < NUM_SYMS; i ++ )
+    put32(&chunks[1].data, i);
+  putStr(&chunks[2].data, "aof_test");
+  for ( int i = 0; i <= NUM_SYMS; i ++ )
+  {
+    bool ref = i == NUM_SYMS;
+    put32(&chunks[3].data, name_offs[ref ? 0 : i]);
+    put32(&chunks[3].data, ref ? 0x2 : 0x3);
+    put32(&chunks[3].data, ref ? 0 : 4 * i);
+    put32(&chunks[3].data, ref ? 0 : area_name);
+  }
+
+  FILE* f = writeChunks(chunks, 5);
+  freeChunks(chunks, 5);
+  AofObj obj;
+  check(f && !AofObj_open(&obj, f), "open");
+  if ( failed )
+    return 1;
+
+  check(obj.syms_len == NUM_SYMS, "one entry per name");
+  check(obj.syms_cap * 3 >= obj.syms_len * 4, "at most 3/4 full");
+  for ( int i = 0; i < NUM_SYMS; i ++ )
+  {
+    AofSym* s = AofObj_lookupSymbol(&obj, names[i]);
+    check(s && s->value == 4 * (uint32_t) i, names[i]);
+  }
+  // the definition comes first, the reference to the same name is not kept
+  AofSym* s = AofObj_lookupSymbol(&obj, "sym0");
+  check(s && (s->attribs & AofSymAttr_DEFINE), "first symbol with a name");
+  check(!AofObj_lookupSymbol(&obj, "sym"), "prefix of a name");
+  check(!AofObj_lookupSymbol(&obj, "sym3000"), "missing name");
+  check(!AofObj_lookupSymbol(&obj, ""), "empty name");
+
+  // growing the table keeps every entry
+  static char more[2000][16];
+  size_t cap = obj.syms_cap;
+  for ( int i = 0; i < 2000; i ++ )
+  {
+    snprintf(more[i], sizeof(more[i]), "more%d", i);
+    SymtabEnt e = { .namelen = strlen(more[i]), .namep = more[i], .p = &obj.aof.syms[i % NUM_SYMS] };
+    check(!Symtab_add(&obj, e), "add");
+  }
+  check(obj.syms_cap > cap, "table grew");
+  check(obj.syms_len == NUM_SYMS + 2000, "entries after growing");
+  for ( int i = 0; i < NUM_SYMS; i ++ )
+    check(AofObj_lookupSymbol(&obj, names[i]) == &obj.aof.syms[i], "old entry after growing");
+  for ( int i = 0; i < 2000; i ++ )
+    check(AofObj_lookupSymbol(&obj, more[i]) == &obj.aof.syms[i % NUM_SYMS], "new entry");
+
+  AofObj_close(&obj);
+  fclose(f);
+
+  if ( failed )
+    return 1;
+  printf("ok\n");
+  return 0;
+}
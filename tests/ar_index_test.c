@@ -0,0 +1,159 @@
+#include "ubu/ar.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * builds an archive of short import members with "ar rcsB" and checks
+ * MappedArchive_lookupSortedSymbol against it
+ */
+
+#define NUM_MEMBERS 42 // the last two both import "dup"
+
+static char dir[] = "ar_index_XXXXXX";
+static char paths[NUM_MEMBERS][64];
+static uint64_t offsets[NUM_MEMBERS];
+
+static size_t failed = 0;
+
+static void check(bool ok, char const* what)
+{
+  if ( !ok )
+  {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failed ++;
+  }
+}
+
+/** a short import member for a code import: defines [sym] and __imp_[sym] */
+static int writeImport(char const* path, char const* sym)
+{
+  static char const dll[] = "test.dll";
+  size_t names = strlen(sym) + 1 + sizeof(dll);
+  uint8_t hd[20] = {
+    0x00, 0x00, 0xFF, 0xFF, // sig1, sig2
+    0x00, 0x00, 0x64, 0x86, // version, machine
+    0, 0, 0, 0,             // time stamp
+    names, names >> 8, 0, 0,
+    0x00, 0x00, 0x04, 0x00, // ordinal, IMPORT_OBJECT_CODE | IMPORT_OBJECT_NAME << 2
+  };
+  FILE* f = fopen(path, "wb");
+  if ( !f )
+    return 1;
+  fwrite(hd, 1, sizeof(hd), f);
+  fwrite(sym, 1, strlen(sym) + 1, f);
+  fwrite(dll, 1, sizeof(dll), f);
+  return fclose(f);
+}
+
+/** [name] has to be defined by member [expected] */
+static void checkFound(MappedArchive const* a, char const* name, size_t expected)
+{
+  uint64_t offset = ~(uint64_t) 0;
+  check(!MappedArchive_lookupSortedSymbol(a, name, &offset) && offset == offsets[expected], name);
+}
+
+static void checkMissing(MappedArchive const* a, char const* name)
+{
+  check(MappedArchive_lookupSortedSymbol(a, name, NULL), name);
+}
+
+int main(int argc, char ** argv)
+{
+  if ( argc != 2 )
+  {
+    fprintf(stderr, "usage: %s <ar>\n", argv[0]);
+    return 2;
+  }
+  if ( !mkdtemp(dir) )
+  {
+    perror(dir);
+    return 2;
+  }
+
+  char archive[64];
+  snprintf(archive, sizeof(archive), "%s/index.a", dir);
+  size_t cmdLen = strlen(argv[1]) + sizeof(archive) + NUM_MEMBERS * 64 + 16;
+  char* cmd = malloc(cmdLen);
+  if ( !cmd )
+    return 2;
+  size_t n = snprintf(cmd, cmdLen, "%s rcsB %s", argv[1], archive);
+  for ( int i = 0; i < NUM_MEMBERS; i ++ )
+  {
+    char sym[16];
+    snprintf(paths[i], sizeof(paths[i]), "%s/m%02d.o", dir, i);
+    snprintf(sym, sizeof(sym), i < NUM_MEMBERS - 2 ? "fn%02d" : "dup", i);
+    check(!writeImport(paths[i], sym), paths[i]);
+    n += snprintf(cmd + n, cmdLen - n, " %s", paths[i]);
+  }
+  check(!failed && !system(cmd), "ar rcsB");
+  free(cmd);
+
+  FILE* f = failed ? NULL : fopen(archive, "rb");
+  MappedArchive a;
+  if ( f && MappedArchive_open(&a, f) )
+  {
+    fclose(f);
+    f = NULL;
+  }
+  check(f, "open");
+
+  if ( f )
+  {
+    // where every member is, for comparing with the index
+    ArMemberView m;
+    size_t i = 0;
+    while ( i < NUM_MEMBERS && MappedArchive_next(&a, &m) )
+    {
+      char const* base = strrchr(paths[i], '/') + 1;
+      check(m.nameLen == strlen(base) && !memcmp(m.name, base, m.nameLen), "member order");
+      offsets[i ++] = m.offset;
+    }
+    check(!MappedArchive_next(&a, &m), "no more members");
+    check(i == NUM_MEMBERS, "member count");
+    check(MappedArchive_hasSortedIndex(&a), "sorted index");
+
+    for ( i = 0; i < NUM_MEMBERS - 2; i ++ )
+    {
+      char sym[16];
+      snprintf(sym, sizeof(sym), "fn%02zu", i);
+      checkFound(&a, sym, i);
+      snprintf(sym, sizeof(sym), "__imp_fn%02zu", i);
+      checkFound(&a, sym, i);
+    }
+
+    // the first and last names of the index, and the names right around them
+    checkFound(&a, "__imp_dup", NUM_MEMBERS - 2);
+    checkFound(&a, "fn39", NUM_MEMBERS - 3);
+    checkMissing(&a, "__imp_duo");
+    checkMissing(&a, "fn40");
+    checkMissing(&a, "");
+    checkMissing(&a, "~");
+
+    // the first member that defines a name
+    checkFound(&a, "dup", NUM_MEMBERS - 2);
+
+    // prefixes and extensions of names that are there
+    checkMissing(&a, "fn");
+    checkMissing(&a, "fn0");
+    checkMissing(&a, "fn000");
+    checkMissing(&a, "__imp_");
+    checkMissing(&a, "dupe");
+
+    MappedArchive_close(&a);
+    fclose(f);
+  }
+
+  for ( int i = 0; i < NUM_MEMBERS; i ++ )
+    remove(paths[i]);
+  remove(archive);
+  rmdir(dir);
+
+  if ( failed )
+    return 1;
+  printf("ok\n");
+  return 0;
+}
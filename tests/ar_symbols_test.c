@@ -0,0 +1,198 @@
+#include "ubu/ar.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * checks SmartArchive_lookupSymbol against hand written archives with every
+ * kind of symbol index, and one without
+ */
+
+typedef enum {
+  INDEX_NONE,
+  INDEX_GNU /** "/", 32 bit big endian */,
+  INDEX_SYM64 /** "/SYM64/", 64 bit big endian */,
+  INDEX_BSD /** "__.SYMDEF", 32 bit little endian */,
+} IndexKind;
+
+#define NUM_MEMBERS 3
+static char const* const members[NUM_MEMBERS] = { "a.o", "b.o", "c.o" };
+
+/** name, index of the member; "dup" is defined by b.o first */
+static struct { char const* name; int member; } const syms[] = {
+  { "alpha", 0 }, { "beta", 1 }, { "dup", 1 }, { "gamma", 2 }, { "dup", 2 }, { "_a", 0 },
+};
+#define NUM_SYMS (sizeof(syms) / sizeof(syms[0]))
+
+typedef struct {
+  uint8_t buf[4096];
+  size_t len;
+} Buf;
+
+static void putBytes(Buf* b, void const* data, size_t len)
+{
+  if ( b->len + len > sizeof(b->buf) )
+    abort();
+  memcpy(b->buf + b->len, data, len);
+  b->len += len;
+}
+
+static void putBe(Buf* b, uint64_t v, size_t bytes)
+{
+  for ( size_t i = bytes; i --; )
+    putBytes(b, &(uint8_t) { v >> (8 * i) }, 1);
+}
+
+static void putLe32(Buf* b, uint32_t v)
+{
+  uint8_t le[4] = { v, v >> 8, v >> 16, v >> 24 };
+  putBytes(b, le, 4);
+}
+
+/** header and data of a member, padded to an even size */
+static void putMember(Buf* b, char const* name, Buf const* data)
+{
+  char hd[61];
+  snprintf(hd, sizeof(hd), "%-16s%-12u%-6u%-6u%-8o%-10zu`\n", name, 0, 0, 0, 0644, data->len);
+  putBytes(b, hd, 60);
+  putBytes(b, data->buf, data->len);
+  if ( b->len % 2 )
+    putBytes(b, "\n", 1);
+}
+
+static void putIndex(Buf* b, IndexKind kind, uint64_t const* offsets)
+{
+  if ( kind == INDEX_GNU || kind == INDEX_SYM64 )
+  {
+    size_t word = kind == INDEX_GNU ? 4 : 8;
+    putBe(b, NUM_SYMS, word);
+    for ( size_t i = 0; i < NUM_SYMS; i ++ )
+      putBe(b, offsets[syms[i].member], word);
+    for ( size_t i = 0; i < NUM_SYMS; i ++ )
+      putBytes(b, syms[i].name, strlen(syms[i].name) + 1);
+  }
+  else if ( kind == INDEX_BSD )
+  {
+    putLe32(b, NUM_SYMS * 8);
+    uint32_t strx = 0;
+    for ( size_t i = 0; i < NUM_SYMS; i ++ )
+    {
+      putLe32(b, strx);
+      putLe32(b, offsets[syms[i].member]);
+      strx += strlen(syms[i].name) + 1;
+    }
+    putLe32(b, strx);
+    for ( size_t i = 0; i < NUM_SYMS; i ++ )
+      putBytes(b, syms[i].name, strlen(syms[i].name) + 1);
+  }
+}
+
+/** a temporary file with the archive; [offsets] of the member headers */
+static FILE* writeArchive(IndexKind kind, uint64_t offsets[NUM_MEMBERS])
+{
+  static char const* const indexNames[] = { NULL, "/", "/SYM64/", "__.SYMDEF" };
+  Buf index = {0}, data = {0};
+  putIndex(&index, kind, (uint64_t[NUM_MEMBERS]) {0});
+
+  // the index has the same size whatever the offsets, which follow from it
+  uint64_t off = 8 + (kind ? 60 + (index.len + 1) / 2 * 2 : 0);
+  for ( int i = 0; i < NUM_MEMBERS; i ++ )
+  {
+    offsets[i] = off;
+    off += 60 + 4;
+  }
+  index.len = 0;
+  putIndex(&index, kind, offsets);
+
+  static Buf ar;
+  ar.len = 0;
+  putBytes(&ar, "!<arch>\n", 8);
+  if ( kind )
+    putMember(&ar, indexNames[kind], &index);
+  for ( int i = 0; i < NUM_MEMBERS; i ++ )
+  {
+    char name[16];
+    snprintf(name, sizeof(name), kind == INDEX_BSD ? "%s" : "%s/", members[i]);
+    data.len = 0;
+    putLe32(&data, i);
+    putMember(&ar, name, &data);
+  }
+
+  FILE* f = tmpfile();
+  if ( f )
+  {
+    fwrite(ar.buf, 1, ar.len, f);
+    rewind(f);
+  }
+  return f;
+}
+
+static size_t failed = 0;
+
+static void check(bool ok, IndexKind kind, char const* what)
+{
+  static char const* const kinds[] = { "no index", "/", "/SYM64/", "__.SYMDEF" };
+  if ( !ok )
+  {
+    fprintf(stderr, "FAILED: %s: %s\n", kinds[kind], what);
+    failed ++;
+  }
+}
+
+/** the member at [offset], as a lookup would be followed up */
+static bool memberAt(SmartArchive* a, uint64_t offset, char const* name)
+{
+  SmartArchive_seekMember(a, offset);
+  char* got = SmartArchive_nextFileNameHeap(a);
+  bool ok = got && !strcmp(got, name);
+  free(got);
+  return ok;
+}
+
+int main(void)
+{
+  for ( IndexKind kind = INDEX_NONE; kind <= INDEX_BSD; kind ++ )
+  {
+    uint64_t offsets[NUM_MEMBERS];
+    FILE* f = writeArchive(kind, offsets);
+    SmartArchive a;
+    if ( !f || SmartArchive_open(&a, f) )
+    {
+      check(false, kind, "open");
+      if ( f )
+        fclose(f);
+      continue;
+    }
+
+    uint64_t offset;
+    for ( size_t i = 0; i < NUM_SYMS; i ++ )
+    {
+      // the first member that defines a name, like a linker would take it
+      int member = strcmp(syms[i].name, "dup") ? syms[i].member : 1;
+      bool found = !SmartArchive_lookupSymbol(&a, syms[i].name, &offset);
+      if ( kind == INDEX_NONE )
+        check(!found, kind, syms[i].name);
+      else
+        check(found && offset == offsets[member] && memberAt(&a, offset, members[member]),
+              kind, syms[i].name);
+    }
+
+    check(SmartArchive_lookupSymbol(&a, "missing", &offset), kind, "missing");
+    check(SmartArchive_lookupSymbol(&a, "alph", &offset), kind, "prefix");
+    check(SmartArchive_lookupSymbol(&a, "alphabet", &offset), kind, "extension");
+    check(SmartArchive_lookupSymbol(&a, "", &offset), kind, "empty name");
+    check(SmartArchive_lookupSymbol(&a, "a.o", &offset), kind, "member name");
+    if ( kind != INDEX_NONE )
+      check(!SmartArchive_lookupSymbol(&a, "gamma", NULL), kind, "lookup without offset");
+
+    SmartArchive_close(&a);
+    fclose(f);
+  }
+
+  if ( failed )
+    return 1;
+  printf("ok\n");
+  return 0;
+}
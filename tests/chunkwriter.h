@@ -0,0 +1,93 @@
+#ifndef _TESTS_CHUNKWRITER_H
+#define _TESTS_CHUNKWRITER_H
+
+/** writes little endian chunk files (AOF objects, ALF libraries) for the tests */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  uint8_t * buf;
+  size_t len;
+  size_t cap;
+} Buf;
+
+static void putBytes(Buf* b, void const* data, size_t len)
+{
+  if ( b->len + len > b->cap )
+  {
+    b->cap = (b->len + len) * 2;
+    b->buf = realloc(b->buf, b->cap);
+    if ( !b->buf )
+      abort();
+  }
+  memcpy(b->buf + b->len, data, len);
+  b->len += len;
+}
+
+static void put32(Buf* b, uint32_t v)
+{
+  uint8_t le[4] = { v, v >> 8, v >> 16, v >> 24 };
+  putBytes(b, le, 4);
+}
+
+/** null terminated, padded to a multiple of 4 */
+static void putStr(Buf* b, char const* s)
+{
+  putBytes(b, s, strlen(s) + 1);
+  while ( b->len % 4 )
+    putBytes(b, "", 1);
+}
+
+typedef struct {
+  char id[9];
+  Buf data;
+} Chunk;
+
+/** a temporary file with [chunks] in that order; NULL on error */
+static FILE* writeChunks(Chunk const* chunks, size_t n)
+{
+  FILE* f = tmpfile();
+  if ( !f )
+    return NULL;
+  Buf hd = {0};
+  put32(&hd, 0xC3CBC6C5);
+  put32(&hd, n);
+  put32(&hd, n);
+  size_t off = 12 + 16 * n;
+  for ( size_t i = 0; i < n; i ++ )
+  {
+    putBytes(&hd, chunks[i].id, 8);
+    put32(&hd, off);
+    put32(&hd, chunks[i].data.len);
+    off += chunks[i].data.len;
+  }
+  fwrite(hd.buf, 1, hd.len, f);
+  for ( size_t i = 0; i < n; i ++ )
+    fwrite(chunks[i].data.buf, 1, chunks[i].data.len, f);
+  free(hd.buf);
+  rewind(f);
+  return f;
+}
+
+static void freeChunks(Chunk* chunks, size_t n)
+{
+  for ( size_t i = 0; i < n; i ++ )
+    free(chunks[i].data.buf);
+}
+
+static size_t failed = 0;
+
+static void check(bool ok, char const* what)
+{
+  if ( !ok )
+  {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failed ++;
+  }
+}
+
+#endif
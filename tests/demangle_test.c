@@ -0,0 +1,70 @@
+#include "ubu/demangle.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * checks Demangler_demangle against a file of "mangled<TAB>expected" lines;
+ * every name is demangled twice, the second time from the cache
+ */
+int main(int argc, char ** argv)
+{
+  if ( argc != 2 )
+  {
+    fprintf(stderr, "usage: %s <pairs file>\n", argv[0]);
+    return 2;
+  }
+
+  FILE* f = fopen(argv[1], "r");
+  if ( !f )
+  {
+    perror(argv[1]);
+    return 2;
+  }
+
+  Demangler d;
+  Demangler_init(&d);
+
+  char * line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  size_t lineno = 0, total = 0, failed = 0;
+  while ( (len = getline(&line, &cap, f)) >= 0 )
+  {
+    lineno ++;
+    if ( len && line[len - 1] == '\n' )
+      line[-- len] = '\0';
+    if ( !len || line[0] == '#' )
+      continue;
+
+    char * tab = strchr(line, '\t');
+    if ( !tab )
+    {
+      fprintf(stderr, "%s:%zu: missing tab\n", argv[1], lineno);
+      failed ++;
+      continue;
+    }
+    *tab = '\0';
+    char const* expected = tab + 1;
+
+    for ( int pass = 0; pass < 2; pass ++ )
+    {
+      char const* dem = Demangler_demangle(&d, line);
+      char const* got = dem ? dem : line;
+      total ++;
+      if ( strcmp(got, expected) )
+      {
+        fprintf(stderr, "%s:%zu: %s\n  expected: %s\n  got:      %s\n",
+                argv[1], lineno, line, expected, got);
+        failed ++;
+      }
+    }
+  }
+
+  free(line);
+  fclose(f);
+  Demangler_free(&d);
+
+  printf("%zu/%zu passed\n", total - failed, total);
+  return failed ? 1 : 0;
+}
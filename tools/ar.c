@@ -1,47 +1,99 @@
 #include "ubu/ar.h"
 #include "ubu/elf.h"
+#include "ubu/pe.h"
+#include "ubu/aof.h"
+#include "ubu/alf.h"
+#include "ubu/filecopy.h"
+#include "ubu/parallel.h"
+#include "ubu/memfile.h"
+#include "ubu/utils.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <utime.h>
+#endif
 
 static void print_usage()
 {
   puts("Usage: ar command archive-file file..."
   "\n" " commands:"
-  "\n" "  t   - display contents of the archive"
-  "\n" "  x   - extract specified files"
+  "\n" "  t   - display contents of the archive, also of ALF libraries"
+  "\n" "  x   - extract specified files, or all files if none are given"
+  "\n" "  xo  - same as x, but keep the stored modification times and modes"
   "\n" "  p   - print specified or all files concatenated"
   "\n" "  rcs - create archive with files and generate symbol indecies"
-  "\n" "  rc  - create archive with files");
+  "\n" "  rc  - create archive with files"
+  "\n" "  add T to rc or rcs to create a thin archive, which only references the files"
+  "\n" "  add B to rc, r or q to write a sorted BSD index (__.SYMDEF SORTED) that can be binary searched"
+  "\n" "  add H to rc to remember a hash of every file; running it again only rewrites what changed."
+  "\n" "      the hashes are an extra member (__.UBUHASH), which GNU ar t and nm show like a file"
+  "\n" "  r   - replace or add files in an existing archive"
+  "\n" "  q   - append files to an existing archive"
+  "\n" "  d   - delete files from an archive"
+  "\n" "  add s to r or q to generate symbol indecies; an existing index is always updated");
 }
 
-static void arDisplayContents(SmartArchive* a)
+/** 0 = ok */
+static int arReadMember(SmartArchive* a, char const* name, void** data, size_t* uz)
 {
-  SmartArchive_rewind(a);
-  char* name;
-  while ( (name = SmartArchive_nextFileNameHeap(a)) )
-  {
-    if ( name[0] && name[0] != '/' )
-      puts(name);
-    free(name);
-    SmartArchive_continueNoData(a);
+  uint64_t offset;
+  if ( SmartArchive_lookupMember(a, name, &offset, NULL) )
+    return 1;
+
+  SmartArchive_seekMember(a, offset);
+  return SmartArchive_continueWithData(data, uz, a);
+}
+
+static void arDisplayContents(FILE* file, char const* path, int* code)
+{
+  MappedArchive a;
+  if ( MappedArchive_open(&a, file) ) {
+    fprintf(stderr, "error reading archive\n");
+    *code = 1;
+    return;
   }
+  MappedArchive_setPath(&a, path);
+
+  ArMemberView m;
+  while ( MappedArchive_next(&a, &m) )
+    printf("%.*s\n", (int) m.nameLen, m.name);
+
+  MappedArchive_close(&a);
+}
+
+static void arDisplayAlf(Alf* alf)
+{
+  AlfMember m;
+  while ( Alf_next(alf, &m) )
+    printf("%.*s\n", (int) m.name_len, m.name);
+}
+
+static int arWriteChunk(void* ctx, void const* data, size_t len)
+{
+  return fwrite(data, 1, len, ctx) != len;
 }
 
+/** members are streamed, so they never have to fit into memory */
 static void arPrintContents(SmartArchive* a, int argc, char** argv, int* code)
 {
   if ( argc )
   {
     for ( int i = 0; i < argc; i ++ )
     {
-      SmartArchive_rewind(a);
-      void* data; size_t uz;
-      if ( SmartArchive_findNext(a, &data, &uz, argv[i]) )
+      uint64_t offset;
+      if ( SmartArchive_lookupMember(a, argv[i], &offset, NULL) )
       {
         fprintf(stderr, "%s not found in archive\n", argv[i]);
         *code = 1;
         continue;
       }
 
-      fwrite(data, 1, uz, stdout);
-      free(data);
+      SmartArchive_seekMember(a, offset);
+      if ( SmartArchive_streamData(a, 0, arWriteChunk, stdout) )
+      {
+        fprintf(stderr, "could not read %s\n", argv[i]);
+        *code = 1;
+      }
     }
   }
   else 
@@ -50,50 +102,283 @@ static void arPrintContents(SmartArchive* a, int argc, char** argv, int* code)
     char* name;
     while ( (name = SmartArchive_nextFileNameHeap(a)) )
     {
+      if ( Ar_isMetaMember(name) )
+        SmartArchive_continueNoData(a);
+      else if ( SmartArchive_streamData(a, 0, arWriteChunk, stdout) )
+      {
+        fprintf(stderr, "could not read %s\n", name);
+        *code = 1;
+      }
       free(name);
-
-      void* data; size_t uz;
-      SmartArchive_continueWithData(&data, &uz, a);
-
-      fwrite(data, 1, uz, stdout);
-      free(data);
     }
   }
 }
 
-static void arExtract(SmartArchive* a, int argc, char** argv, int* code)
+/**
+ * the file that member [name] is extracted to. names come from the archive and
+ * long ones keep their slashes, so only the last component is used: nothing is
+ * ever written outside of the current directory.
+ * NULL if that is not a file name
+ */
+static char const* arOutName(char const* name)
 {
-  if ( !argc )
-  {
-    fprintf(stderr, "no files specified\n");
-    *code = 1;
-    return;
-  }
+  char const* base = name;
+  for ( char const* p = name; *p; p ++ )
+    if ( *p == '/' || *p == '\\' )
+      base = p + 1;
+  if ( !*base || !strcmp(base, ".") || !strcmp(base, "..") )
+    return NULL;
+  return base;
+}
 
-  for ( int i = 0; i < argc; i ++ )
+/** members of thin archives are read into memory first: they might be the very files that get written */
+static void arExtractThin(SmartArchive* a, int argc, char** argv, int* code)
+{
+  SmartArchive_rewind(a);
+  int i = 0;
+  for (;;)
   {
-    SmartArchive_rewind(a);
     void* data; size_t uz;
-    if ( SmartArchive_findNext(a, &data, &uz, argv[i]) )
+    char* name;
+    if ( argc )
     {
-      fprintf(stderr, "%s not found in archive\n", argv[i]);
-      *code = 1;
-      continue;
+      if ( i == argc ) break;
+      name = argv[i ++];
+      if ( arReadMember(a, name, &data, &uz) )
+      {
+        fprintf(stderr, "%s not found in archive\n", name);
+        *code = 1;
+        continue;
+      }
+    }
+    else
+    {
+      name = SmartArchive_nextFileNameHeap(a);
+      if ( !name ) break;
+      if ( Ar_isMetaMember(name) )
+      {
+        SmartArchive_continueNoData(a);
+        free(name);
+        continue;
+      }
+      if ( SmartArchive_continueWithData(&data, &uz, a) )
+      {
+        fprintf(stderr, "could not read %s\n", name);
+        *code = 1;
+        free(name);
+        continue;
+      }
     }
 
-    FILE* fp = fopen(argv[i], "wb");
+    char const* out = arOutName(name);
+    FILE* fp = out ? fopen(out, "wb") : NULL;
     if ( fp )
     {
       fwrite(data, 1, uz, fp);
       fclose(fp);
     }
+    else if ( !out )
+    {
+      fprintf(stderr, "%s: not a valid file name, not extracted\n", name);
+      *code = 1;
+    }
     else 
     {
-      fprintf(stderr, "could not open file %s for writing\n", argv[i]);
+      fprintf(stderr, "could not open file %s for writing\n", out);
     }
 
     free(data);
+    if ( !argc )
+      free(name);
+  }
+}
+
+typedef struct {
+  char* name /** of the file that is written, see arOutName */;
+  uint64_t data_off;
+  uint64_t size;
+  Ar_FileHeader const* hdr;
+  bool failed;
+} ArExtractEnt;
+
+typedef struct {
+  ArExtractEnt* ents;
+  FILE* archive;
+  void const* map;
+  /** o: stored mtime and mode */
+  bool keep_meta;
+} ArExtractJob;
+
+static void arApplyMeta(char const* path, Ar_FileHeader const* hd)
+{
+#ifndef _WIN32
+  char tmp[13];
+  memcpy(tmp, hd->octal_file_mode, 8);
+  tmp[8] = '\0';
+  char* end;
+  unsigned long mode = strtoul(tmp, &end, 8);
+  if ( end != tmp )
+    chmod(path, mode & 07777);
+
+  memcpy(tmp, hd->decimal_file_modific_timestamp, 12);
+  tmp[12] = '\0';
+  long long mtime = strtoll(tmp, &end, 10);
+  if ( end != tmp ) {
+    struct utimbuf t = { (time_t) mtime, (time_t) mtime };
+    utime(path, &t);
+  }
+#endif
+}
+
+static void arExtractOne(void* ctx, size_t i)
+{
+  ArExtractJob* job = ctx;
+  ArExtractEnt* e = &job->ents[i];
+
+  FILE* out = fopen(e->name, "wb");
+  if ( !out ) {
+    e->failed = true;
+    return;
+  }
+  File_presize(out, e->size);
+  if ( File_copyRangeMapped(out, 0, job->archive, job->map, e->data_off, e->size) )
+    e->failed = true;
+  if ( fclose(out) )
+    e->failed = true;
+
+  if ( job->keep_meta && !e->failed )
+    arApplyMeta(e->name, e->hdr);
+}
+
+static int ext_ent_cmp(void const* a, void const* b)
+{
+  ArExtractEnt const* x = a;
+  ArExtractEnt const* y = b;
+  int c = strcmp(x->name, y->name);
+  if ( c )
+    return c;
+  return x->data_off < y->data_off ? -1 : x->data_off > y->data_off;
+}
+
+static int str_ptr_cmp(void const* a, void const* b)
+{
+  return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/** without names, the whole archive is extracted */
+static void arExtract(SmartArchive* sa, FILE* file, int argc, char** argv, bool keep_meta, int* code)
+{
+  MappedArchive a;
+  if ( MappedArchive_open(&a, file) ) {
+    fprintf(stderr, "error reading archive\n");
+    *code = 1;
+    return;
+  }
+
+  if ( a.thin ) {
+    MappedArchive_close(&a);
+    arExtractThin(sa, argc, argv, code);
+    return;
+  }
+
+  // requested names, sorted; each one is taken from its first member
+  char* wanted[argc ? argc : 1];
+  bool found[argc ? argc : 1];
+  for ( int i = 0; i < argc; i ++ ) {
+    wanted[i] = argv[i];
+    found[i] = false;
+  }
+  qsort(wanted, argc, sizeof(char*), str_ptr_cmp);
+
+  ArExtractEnt* ents = NULL;
+  size_t len = 0, cap = 0;
+
+  ArMemberView v;
+  char* name = NULL;
+  size_t name_cap = 0;
+  while ( MappedArchive_next(&a, &v) )
+  {
+    if ( ArMemberView_nameStr(&v, &name, &name_cap) ) {
+      *code = 1;
+      break;
+    }
+
+    if ( argc ) {
+      char** w = bsearch(&name, wanted, argc, sizeof(char*), str_ptr_cmp);
+      if ( !w )
+        continue;
+      // the same name might be requested more than once
+      while ( w > wanted && !strcmp(w[-1], name) )
+        w --;
+      if ( found[w - wanted] )
+        continue;
+      for ( char** s = w; s < wanted + argc && !strcmp(*s, name); s ++ )
+        found[s - wanted] = true;
+    }
+
+    if ( len == cap ) {
+      size_t ncap = cap ? cap * 2 : 64;
+      ArExtractEnt* n = realloc(ents, ncap * sizeof(ArExtractEnt));
+      if ( !n ) {
+        *code = 1;
+        break;
+      }
+      ents = n;
+      cap = ncap;
+    }
+
+    char const* out = arOutName(name);
+    if ( !out ) {
+      fprintf(stderr, "%s: not a valid file name, not extracted\n", name);
+      *code = 1;
+      continue;
+    }
+
+    ArExtractEnt* e = &ents[len];
+    e->name = strdup(out);
+    e->data_off = v.data - (uint8_t const*) a.map.data;
+    e->size = v.size;
+    e->hdr = (Ar_FileHeader const*) ((uint8_t const*) a.map.data + v.offset);
+    e->failed = false;
+    if ( !e->name ) {
+      *code = 1;
+      break;
+    }
+    len ++;
+  }
+  free(name);
+
+  for ( int i = 0; i < argc; i ++ ) {
+    if ( !found[i] ) {
+      fprintf(stderr, "%s not found in archive\n", wanted[i]);
+      *code = 1;
+    }
+  }
+
+  // members that go to the same file would be written by two threads at once:
+  // only the last one is extracted, as if they were extracted in order
+  qsort(ents, len, sizeof(ArExtractEnt), ext_ent_cmp);
+  size_t uniq = 0;
+  for ( size_t i = 0; i < len; i ++ ) {
+    if ( i + 1 < len && !strcmp(ents[i].name, ents[i + 1].name) ) {
+      free(ents[i].name);
+      continue;
+    }
+    ents[uniq ++] = ents[i];
+  }
+
+  ArExtractJob job = { ents, file, a.map.data, keep_meta };
+  Parallel_for(uniq, 0, arExtractOne, &job);
+
+  for ( size_t i = 0; i < uniq; i ++ ) {
+    if ( ents[i].failed ) {
+      fprintf(stderr, "could not write %s\n", ents[i].name);
+      *code = 1;
+    }
+    free(ents[i].name);
   }
+  free(ents);
+  MappedArchive_close(&a);
 }
 
 static void init_ar_header(Ar_FileHeader* header, bool is_idx)
@@ -120,258 +405,1778 @@ static void no_nt_strcpy(char * dest, const char * src)
   memcpy(dest, src, len);
 }
 
-// TODO: endianess
-static int gen_ar(char * out, char ** ins, size_t num_ins, bool ranlib) {
-  FILE* outf = fopen(out, "wb");
-  if (out == NULL) {
-    fprintf(stderr, "Can't create output file\n");
-    return 1;
-  }
-
-  static char magic[8] = "!<arch>\x0A";
-  fwrite(magic, 1, 8, outf);
+/** the "/" and "/SYM64/" indices store all numbers big endian, [word] bytes wide */
+static void put_be(uint8_t* dest, uint64_t v, size_t word)
+{
+  for (size_t i = 0; i < word; i ++)
+    dest[i] = v >> (8 * (word - 1 - i));
+}
 
-  int code = 0;
+/** the size field only has 10 decimal digits */
+#define AR_MAX_MEMBER_SIZE (9999999999ull)
 
-  char* filenames = NULL;
-  size_t filenames_len = 0;
+/** member data has to start at an even offset */
+static void pad_member(FILE* outf, size_t size)
+{
+  if (size & 1)
+    fputc('\n', outf);
+}
 
-  FILE* handles[num_ins];
-  size_t fnidc[num_ins];
-  for (size_t i = 0; i < num_ins; i ++)
+/** defined global symbols of one input, for the archive symbol index */
+typedef struct {
+  /** null terminated names, back to back */
+  char* names;
+  size_t names_len;
+  size_t names_cap;
+  size_t count;
+  bool failed;
+} ArInputSyms;
+
+typedef struct {
+  FILE** handles;
+  ArInputSyms* out;
+} ArSymJob;
+
+/** 0 = ok */
+static int arSymsAppend(ArInputSyms* dest, char const* name, size_t len)
+{
+  if ( dest->names_len + len + 1 > dest->names_cap )
   {
-    FILE* infile = fopen(ins[i], "rb");
-    if (infile == NULL) {
-      fprintf(stderr, "Can't open %s\n", ins[i]);
-      code = 1;
-      handles[i] = NULL;
-      continue;
-    }
-    handles[i] = infile;
-
-    size_t fnidx = filenames_len;
-    size_t fnlen = strlen(ins[i]);
-    filenames = realloc(filenames, filenames_len + fnlen + 2);
-    memcpy(filenames + filenames_len, ins[i], fnlen);
-    filenames_len += fnlen;
-    filenames[filenames_len++] = '/';
-    filenames[filenames_len++] = '\n';
-
-    fnidc[i] = fnidx;
+    size_t cap = dest->names_cap ? dest->names_cap * 2 : 256;
+    while ( cap < dest->names_len + len + 1 )
+      cap *= 2;
+    char* names = realloc(dest->names, cap);
+    if ( !names )
+      return 1;
+    dest->names = names;
+    dest->names_cap = cap;
   }
 
-  uint32_t * syms_offs = NULL;
-  size_t syms_offs_len = 0;
-
-  char * syms_names = NULL;
-  size_t syms_names_len = 0;
+  memcpy(dest->names + dest->names_len, name, len);
+  dest->names_len += len;
+  dest->names[dest->names_len ++] = '\0';
+  dest->count ++;
+  return 0;
+}
 
-  size_t where_write_offsets = 0;
+/** only looks at the magic bytes, so every input is parsed by one reader only */
+static ObjFmt arDetectFormat(FILE* file)
+{
+  unsigned char m[4] = {0};
+  rewind(file);
+  size_t got = fread(m, 1, 4, file);
+  rewind(file);
+  return ObjFmt_detect(m, got);
+}
 
-  size_t * file2offs[num_ins];
-  size_t   file2offs_len[num_ins];
-  memset(file2offs, 0, sizeof(file2offs));
-  memset(file2offs_len, 0, sizeof(file2offs_len));
+/** 0 = ok */
+static int arCollectElf(ArInputSyms* dest, FILE* infile)
+{
+  OpElf elf;
+  if ( OpElf_open(&elf, infile, NULL) )
+    return 1;
 
-  if (ranlib) {
-    for (size_t i = 0; i < num_ins; i ++) {
-      FILE* infile = handles[i];
-      rewind(infile);
+  int err = 0;
+  ssize_t symtab = OpElf_findSection(&elf, ".symtab");
+  if ( symtab == -1 )
+    symtab = OpElf_findSection(&elf, ".dynsym");
 
-      OpElf elf;
-      if ( OpElf_open(&elf, infile, NULL) ) {
-        printf("could not generate symbol indexes for %s\n", ins[i]);
-        continue;
-      }
+  if ( symtab != -1 )
+  {
+    Elf64_SectionHeader sec = elf.sectionHeaders[symtab];
 
-      ssize_t symtab = OpElf_findSection(&elf, ".symtab");
-      if ( symtab == -1 )
-        symtab = OpElf_findSection(&elf, ".dynsym");
+    char * strtab;
+    size_t strtab_len;
+    if ( !Elf_getStrTable(&strtab, &strtab_len, sec.sh_link, &elf.header, elf.file, NULL) )
+    {
+      // sh_info is one past the last local symbol, and locals never go
+      // into the index, so they are not even read
+      size_t first = sec.sh_info > 1 ? sec.sh_info : 1; // first symbol is fake
 
-      if ( symtab != -1 )
+      Elf64_Sym* syms = NULL;
+      size_t syms_len = 0;
+      if ( !Elf_getSymTableFrom(&syms, &syms_len, first, &elf.header, &sec, elf.file, NULL) )
       {
-        Elf64_SectionHeader sec = elf.sectionHeaders[symtab];
-
-        char * tsstab;
-        if ( !Elf_getStrTable(&tsstab, NULL, sec.sh_link, &elf.header, elf.file, NULL) )
+        for (size_t u = 0; u < syms_len && !err; u++)
         {
-          Elf64_Sym* syms;
-          size_t syms_len = 0;
-          if ( !Elf_getSymTable(&syms, &syms_len, &elf.header, &sec, elf.file, NULL) )
-          {
-            if ( syms_len ) {
-              // first symbol is fake
-              syms_len --;
-              syms ++;
-            }
-
-            for (size_t u = 0; u < syms_len; u++)
-            {
-              uint8_t bind_attrib = syms[u].info >> 4;
-              uint8_t sym_type = syms[u].info & 0xF;
-
-              const char * sname = NULL;
-              {
-                uint32_t sectionnam = 0;
-                if ( syms[u].shndx && syms[u].shndx < elf.header.part3.shnum )
-                  sectionnam = elf.sectionHeaders[syms[u].shndx].sh_name;
-                if ( sectionnam ) 
-                  sname = elf.master_strtab + sectionnam;
-              }
-
-              bool is_global = u >= sec.sh_info;
-
-              if (is_global) {
-                size_t slen = strlen(sname);
-                syms_names = realloc(syms_names, syms_names_len + slen + 1);
-                memcpy(syms_names + syms_names_len, sname, slen);
-                syms_names_len += slen;
-                syms_names[syms_names_len++] = '/';
-
-                syms_offs = realloc(syms_offs, (syms_offs_len + 1) * sizeof(uint32_t));
-                syms_offs[syms_offs_len] = 0; // will be overwritten later
-
-                file2offs[i] = realloc(file2offs[i], file2offs_len[i] + 1);
-                file2offs[i][file2offs_len[i]++] = syms_offs_len;
-
-                syms_offs_len ++;
-              }
-            }
-
-            free(syms);
-          }
-
-          free(tsstab);
+          Elf64_Sym const* sym = &syms[u];
+          uint8_t bind_attrib = sym->info >> 4;
+          if ( bind_attrib == 0 /* local */ || sym->shndx == SHN_UNDEF || sym->name >= strtab_len )
+            continue;
+
+          char const* name = strtab + sym->name;
+          size_t len = strnlen(name, strtab_len - sym->name);
+          if ( len )
+            err = arSymsAppend(dest, name, len);
         }
+
+        free(syms);
       }
 
-      OpElf_close(&elf);
+      free(strtab);
     }
+  }
 
-    if ( syms_offs_len > 0 )
-    {
-      Ar_FileHeader header;
-      init_ar_header(&header, true);
-      no_nt_strcpy(header.filename, "/");
-      char _filesize[20];
-      sprintf(_filesize, "%zu", sizeof(uint32_t) + sizeof(uint32_t) * syms_offs_len + syms_names_len);
-      no_nt_strcpy(header.decimal_file_size, _filesize);
-
-      fwrite(&header, 1, sizeof(header), outf);
+  OpElf_close(&elf);
+  return err;
+}
 
-      uint32_t num_ents = syms_offs_len;
-      fwrite(&num_ents, 1, sizeof(num_ents), outf);
+/** 0 = ok */
+static int arCollectPe(ArInputSyms* dest, FILE* infile)
+{
+  OpPe pe;
+  if ( OpPe_open(&pe, infile) )
+    return 1;
 
-      where_write_offsets = ftell(outf);
-      fwrite(syms_offs, 1, syms_offs_len * sizeof(uint32_t), outf);
-      fwrite(syms_names, 1, syms_names_len, outf);
+  int err = 0;
+  OpPe_rewindToSyms(&pe);
+  for ( size_t i = 0; i < pe.header.numCoffSym && !err; i ++ )
+  {
+    CoffSym sym;
+    OpPe_nextSym(&sym, &pe);
 
-      free(syms_names);
+    // external and either in a section, absolute or common (value = size)
+    bool is_defined = sym.sectionId != 0 || sym.value != 0;
+    if ( sym.storageClass == IMAGE_SYM_CLASS_EXTERNAL && is_defined && sym.sectionId != 0xFFFE )
+    {
+      const char * name = CoffSym_name(&sym, &pe);
+      // short names are not null terminated if they use all 8 bytes
+      size_t len = name == sym.name ? strnlen(name, 8) : strlen(name);
+      if ( len )
+        err = arSymsAppend(dest, name, len);
     }
+
+    uint8_t numAux = sym.numAuxSyms;
+    for ( size_t j = 0; j < numAux; j ++ )
+      OpPe_nextSym(&sym, &pe);
+    i += numAux;
   }
 
-  {
-    Ar_FileHeader header;
-    init_ar_header(&header, true);
-    no_nt_strcpy(header.filename, "//");
-    char _filesize[20];
-    sprintf(_filesize, "%zu", filenames_len);
-    no_nt_strcpy(header.decimal_file_size, _filesize);
+  OpPe_close(&pe);
+  return err;
+}
 
-    fwrite(&header, 1, sizeof(header), outf);
-    fwrite(filenames, 1, filenames_len, outf);
+/** 0 = ok */
+static int arCollectAof(ArInputSyms* dest, FILE* infile)
+{
+  AofObj aof;
+  if ( AofObj_open(&aof, infile) )
+    return 1;
+
+  int err = 0;
+  for ( size_t i = 0; i < aof.aof.header.num_syms && !err; i ++ )
+  {
+    AofSym const* sym = &aof.aof.syms[i];
+    if ( (sym->attribs & (AofSymAttr_DEFINE | AofSymAttr_GLOBAL)) != (AofSymAttr_DEFINE | AofSymAttr_GLOBAL) )
+      continue;
 
-    free(filenames);
+    // AofObj_open already made sure that every name resolves
+    char const* name = ChunkFile_getStr(&aof.ch, sym->name);
+    size_t len = strlen(name);
+    if ( len )
+      err = arSymsAppend(dest, name, len);
   }
 
-  for (size_t i = 0; i < num_ins; i ++)
+  AofObj_close(&aof);
+  return err;
+}
+
+/** short import members are tiny; 0 = ok */
+static int arCollectImport(ArInputSyms* dest, FILE* infile)
+{
+  fseeko(infile, 0, SEEK_END);
+  off_t size = ftello(infile);
+  if ( size <= 0 || size > 64 * 1024 )
+    return 1;
+  char* data = malloc(size);
+  rewind(infile);
+  CoffImport imp;
+  int err = !data || fread(data, 1, size, infile) != (size_t) size ||
+            CoffImport_parse(&imp, data, size);
+
+  // the import table slot, and the thunk of code imports
+  size_t len = err ? 0 : strlen(imp.symbol);
+  char* slot = err ? NULL : malloc(len + 7);
+  err = err || !slot;
+  if ( !err )
   {
-    FILE* infile = handles[i];
-    if (infile == NULL) continue;
-    size_t off = ftell(outf);
+    memcpy(slot, "__imp_", 6);
+    memcpy(slot + 6, imp.symbol, len + 1);
+    err = arSymsAppend(dest, slot, len + 6);
+  }
+  if ( !err && imp.type == IMPORT_OBJECT_CODE )
+    err = arSymsAppend(dest, imp.symbol, len);
 
-    for (size_t o = 0; o < file2offs_len[i]; o ++)
-      syms_offs[file2offs[i][o]] = off;
+  free(slot);
+  free(data);
+  return err;
+}
 
-    fseek(infile, 0, SEEK_END);
-    size_t filesize = ftell(infile);
-    rewind(infile);
+static void arCollectFile(ArInputSyms* dest, FILE* infile)
+{
+  int err = 1;
+  switch ( arDetectFormat(infile) )
+  {
+    case ObjFmt_ELF: err = arCollectElf(dest, infile); break;
+    case ObjFmt_PE:  err = arCollectPe(dest, infile); break;
+    case ObjFmt_AOF: err = arCollectAof(dest, infile); break;
+    case ObjFmt_COFF_IMPORT: err = arCollectImport(dest, infile); break;
+    default: break;
+  }
 
-    Ar_FileHeader header;
-    init_ar_header(&header, false);
-    char _filename[20];
-    sprintf(_filename, "/%zu", fnidc[i]);
-    no_nt_strcpy(header.filename, _filename);
-    char _filesize[20];
-    sprintf(_filesize, "%zu", filesize);
-    no_nt_strcpy(header.decimal_file_size, _filesize);
+  dest->failed = err != 0;
+}
 
-    fwrite(&header, 1, sizeof(header), outf);
+/** runs on the worker pool; only touches input [i] */
+static void arCollectSyms(void* ctx, size_t i)
+{
+  ArSymJob* job = ctx;
+  if ( job->handles[i] )
+    arCollectFile(&job->out[i], job->handles[i]);
+}
 
-    char* infp = malloc(filesize);
-    fread(infp, 1, filesize, infile);
-    fwrite(infp, 1, filesize, outf);
-    free(infp);
+/**
+ * [path] relative to the directory [dir]; both have to be absolute and canonical.
+ * heap
+ */
+static char* rel_path(char const* dir, char const* path)
+{
+  size_t i = 0, common = 0;
+  for (; dir[i] && dir[i] == path[i]; i ++)
+    if (dir[i] == '/')
+      common = i + 1;
+
+  char const* rest;
+  if (!dir[i] && path[i] == '/') {
+    rest = "";
+    common = i + 1;
+  } else {
+    rest = dir + common;
   }
 
-  if (where_write_offsets != 0) {
-    fseek(outf, where_write_offsets, SEEK_SET);
-    fwrite(syms_offs, 1, syms_offs_len * sizeof(uint32_t), outf);
+  size_t ups = 0;
+  if (*rest) {
+    ups = 1;
+    for (char const* c = rest; *c; c ++)
+      if (*c == '/')
+        ups ++;
   }
 
-  free(syms_offs);
+  size_t len = strlen(path + common);
+  char* res = malloc(ups * 3 + len + 1);
+  if (!res)
+    return NULL;
+  for (size_t u = 0; u < ups; u ++)
+    memcpy(res + u * 3, "../", 3);
+  memcpy(res + ups * 3, path + common, len + 1);
+  return res;
+}
 
-  for (size_t i = 0; i < num_ins; i ++) {
-    if (handles[i]) {
-      fclose(handles[i]);
-      free(file2offs[i]);
-    }
+/**
+ * the name a member gets: regular archives only store the file name,
+ * thin archives the path relative to the archive, so it can be found later.
+ * heap
+ */
+static char* member_name(char const* archive, char const* in, bool thin)
+{
+  if (!thin) {
+    char const* slash = strrchr(in, '/');
+    return strdup(slash ? slash + 1 : in);
   }
 
-  fclose(outf);
+  if (in[0] == '/' || !strchr(archive, '/'))
+    return strdup(in);
+
+#ifdef _WIN32
+  return strdup(in);
+#else
+  char* dir = strdup(archive);
+  if (!dir)
+    return NULL;
+  *strrchr(dir, '/') = '\0';
+
+  char* absDir = realpath(*dir ? dir : "/", NULL);
+  char* absIn = realpath(in, NULL);
+  char* res = absDir && absIn ? rel_path(absDir, absIn) : NULL;
+  free(dir);
+  free(absDir);
+  free(absIn);
+  return res;
+#endif
+}
 
-  return code;
+/** room for later edits */
+static uint64_t ar_reserve(uint64_t needed)
+{
+  uint64_t r = needed + needed / 4 + 64;
+  return r + (r & 1);
 }
 
-int main(int argc, char** argv)
+typedef struct {
+  char const* name;
+  uint32_t strx;
+  uint32_t off;
+  size_t ord;
+} ArSortedSym;
+
+static int sorted_sym_cmp(void const* a, void const* b)
 {
-  if (argc < 3) {
-    print_usage();
-    return 1;
-  }
+  ArSortedSym const* x = a;
+  ArSortedSym const* y = b;
+  int c = strcmp(x->name, y->name);
+  if (c)
+    return c;
+  // stable, so the first member that defines a name is found first
+  return x->ord < y->ord ? -1 : x->ord > y->ord;
+}
 
-  if (!strcmp("rcs", argv[1])) {
-    return gen_ar(argv[2], argv + 3, argc - 3, true);
-  }
+/** BSD name of the sorted index, padded with zeros as ld64 does */
+#define BSD_SYMDEF_NAME "__.SYMDEF SORTED\0\0\0\0"
+#define BSD_SYMDEF_NAME_LEN 20
 
-  if (!strcmp("rc", argv[1])) {
-    return gen_ar(argv[2], argv + 3, argc - 3, false);
-  }
+static void put_le32(uint8_t* dest, uint32_t v)
+{
+  for (size_t i = 0; i < 4; i ++)
+    dest[i] = v >> (8 * i);
+}
 
-  char mode = argv[1][0];
+/** size of the sorted BSD index for [syms]; [syms][i] NULL is skipped */
+static uint64_t sorted_index_size(ArInputSyms const* const* syms, size_t n)
+{
+  uint64_t size = 8;
+  for (size_t i = 0; i < n; i ++)
+    if (syms[i])
+      size += 8 * syms[i]->count + syms[i]->names_len;
+  return size;
+}
 
-  if ( argv[1][1] || !strchr("txp", mode) ) {
-    print_usage();
+/**
+ * "__.SYMDEF SORTED": ranlib array size, {strx, offset} pairs sorted by name,
+ * string table size, strings; all little endian.
+ * MappedArchive_lookupSortedSymbol binary searches it without building anything.
+ * [buf] has to be at least sorted_index_size() bytes, every offset has to fit
+ * into 32 bits
+ * 0 = ok
+ */
+static int fill_sorted_index(uint8_t* buf, ArInputSyms const* const* syms, uint64_t const* offs, size_t n)
+{
+  size_t count = 0;
+  uint64_t str_size = 0;
+  for (size_t i = 0; i < n; i ++)
+    if (syms[i]) {
+      count += syms[i]->count;
+      str_size += syms[i]->names_len;
+    }
+
+  ArSortedSym* sorted = malloc(sizeof(ArSortedSym) * (count ? count : 1));
+  if (!sorted)
     return 1;
+
+  // the string table keeps the input order, only the pairs are sorted
+  char* strs = (char*) buf + 8 + 8 * count;
+  size_t at = 0, k = 0;
+  for (size_t i = 0; i < n; i ++)
+  {
+    if (!syms[i]) continue;
+    char const* name = syms[i]->names;
+    for (size_t s = 0; s < syms[i]->count; s ++)
+    {
+      size_t len = strlen(name);
+      sorted[k] = (ArSortedSym) { strs + at, at, offs[i], k };
+      memcpy(strs + at, name, len + 1);
+      at += len + 1;
+      name += len + 1;
+      k ++;
+    }
   }
 
-  FILE* file = fopen(argv[2], "rb");
-  if ( !file ) {
-    fprintf(stderr, "could not open file\n");
-    return 1;
+  qsort(sorted, count, sizeof(ArSortedSym), sorted_sym_cmp);
+
+  put_le32(buf, count * 8);
+  for (size_t i = 0; i < count; i ++) {
+    put_le32(buf + 4 + 8 * i, sorted[i].strx);
+    put_le32(buf + 8 + 8 * i, sorted[i].off);
+  }
+  put_le32(buf + 4 + 8 * count, str_size);
+
+  free(sorted);
+  return 0;
+}
+
+/** writes the AR_MANIFEST_NAME member with room for later edits; see ar_hashed */
+static void write_manifest(FILE* outf, char const* manifest, size_t len, uint64_t reserved)
+{
+  Ar_FileHeader header;
+  init_ar_header(&header, true);
+  no_nt_strcpy(header.filename, AR_MANIFEST_NAME "/");
+  char _filesize[21];
+  sprintf(_filesize, "%llu", (unsigned long long) reserved);
+  no_nt_strcpy(header.decimal_file_size, _filesize);
+
+  fwrite(&header, 1, sizeof(header), outf);
+  fwrite(manifest, 1, len, outf);
+  for (uint64_t i = len; i < reserved; i ++)
+    fputc('\n', outf);
+  pad_member(outf, reserved);
+}
+
+/** [manifest] NULL = none */
+static int gen_ar(char * out, char ** ins, size_t num_ins, bool ranlib, bool thin, bool sorted,
+                  char const* manifest, size_t manifest_len) {
+  FILE* outf = fopen(out, "wb");
+  if (outf == NULL) {
+    fprintf(stderr, "Can't create output file\n");
+    return 1;
+  }
+
+  fwrite(thin ? "!<thin>\x0A" : "!<arch>\x0A", 1, 8, outf);
+
+  int code = 0;
+
+  char* filenames = NULL;
+  size_t filenames_len = 0;
+
+  FILE* handles[num_ins];
+  size_t fnidc[num_ins];
+  size_t fnlens[num_ins];
+  uint64_t filesizes[num_ins];
+  for (size_t i = 0; i < num_ins; i ++)
+  {
+    FILE* infile = fopen(ins[i], "rb");
+    if (infile == NULL) {
+      fprintf(stderr, "Can't open %s\n", ins[i]);
+      code = 1;
+      handles[i] = NULL;
+      continue;
+    }
+
+    fseeko(infile, 0, SEEK_END);
+    filesizes[i] = ftello(infile);
+    if (filesizes[i] > AR_MAX_MEMBER_SIZE) {
+      fprintf(stderr, "%s is too big for an archive member\n", ins[i]);
+      code = 1;
+      fclose(infile);
+      handles[i] = NULL;
+      continue;
+    }
+    handles[i] = infile;
+
+    char* name = member_name(out, ins[i], thin);
+    if (name == NULL) {
+      fprintf(stderr, "Can't resolve %s\n", ins[i]);
+      code = 1;
+      fclose(infile);
+      handles[i] = NULL;
+      continue;
+    }
+
+    size_t fnidx = filenames_len;
+    size_t fnlen = strlen(name);
+    filenames = realloc(filenames, filenames_len + fnlen + 2);
+    memcpy(filenames + filenames_len, name, fnlen);
+    filenames_len += fnlen;
+    filenames[filenames_len++] = '/';
+    filenames[filenames_len++] = '\n';
+    free(name);
+
+    fnidc[i] = fnidx;
+    fnlens[i] = fnlen;
+  }
+
+  uint8_t * syms_offs = NULL;
+  size_t syms_offs_len = 0;
+
+  char * syms_names = NULL;
+  size_t syms_names_len = 0;
+
+  ArInputSyms in_syms[num_ins];
+  memset(in_syms, 0, sizeof(in_syms));
+
+  if (ranlib) {
+    ArSymJob job = { handles, in_syms };
+    Parallel_for(num_ins, 0, arCollectSyms, &job);
+
+    // merged in input order, so the index does not depend on scheduling
+    for (size_t i = 0; i < num_ins; i ++) {
+      if (in_syms[i].failed)
+        printf("could not generate symbol indexes for %s\n", ins[i]);
+      syms_offs_len += in_syms[i].count;
+      syms_names_len += in_syms[i].names_len;
+    }
+
+    // room for "/SYM64/" offsets, in case they are needed
+    syms_offs = malloc(syms_offs_len * sizeof(uint64_t) + 1);
+    syms_names = malloc(syms_names_len + 1);
+    if (!syms_offs || !syms_names) {
+      fprintf(stderr, "out of memory\n");
+      syms_offs_len = syms_names_len = 0;
+      code = 1;
+    }
+
+    size_t names_at = 0;
+    for (size_t i = 0; i < num_ins; i ++) {
+      if (syms_names && in_syms[i].names_len) {
+        memcpy(syms_names + names_at, in_syms[i].names, in_syms[i].names_len);
+        names_at += in_syms[i].names_len;
+      }
+    }
+  }
+
+  // everything is known now, so every member offset can be computed up front.
+  // if one does not fit into 32 bits, the index has to be a "/SYM64/" one,
+  // which is bigger and moves every member, so the layout is done again
+  uint64_t member_offs[num_ins];
+  size_t name_stored[num_ins];
+  uint64_t manifest_reserved = manifest ? ar_reserve(manifest_len) : 0;
+  size_t word = 4;
+  size_t syms_size;
+  uint64_t pos;
+  ArInputSyms const* syms[num_ins];
+  for (size_t i = 0; i < num_ins; i ++)
+    syms[i] = handles[i] ? &in_syms[i] : NULL;
+  for (;;)
+  {
+    syms_size = sorted ? sorted_index_size(syms, num_ins)
+                       : word + word * syms_offs_len + syms_names_len;
+    pos = 8;
+    if ( syms_offs_len > 0 ) {
+      uint64_t stored = (sorted ? BSD_SYMDEF_NAME_LEN : 0) + syms_size;
+      pos += sizeof(Ar_FileHeader) + stored + (stored & 1);
+    }
+    // BSD archives keep long names in front of the data instead
+    if ( !sorted )
+      pos += sizeof(Ar_FileHeader) + filenames_len + (filenames_len & 1);
+    if ( manifest )
+      pos += sizeof(Ar_FileHeader) + manifest_reserved;
+
+    uint64_t last_off = 0;
+    for (size_t i = 0; i < num_ins; i ++)
+    {
+      if (handles[i] == NULL) continue;
+      member_offs[i] = last_off = pos;
+      pos += sizeof(Ar_FileHeader);
+      // thin archives only have the header.
+      // BSD names are padded with zeros so the data is 8 byte aligned, as ld64 does
+      name_stored[i] = sorted ? fnlens[i] + (8 - (pos + fnlens[i]) % 8) % 8 : 0;
+      uint64_t stored = name_stored[i] + filesizes[i];
+      if (!thin)
+        pos += stored + (stored & 1);
+    }
+
+    if ( syms_offs_len == 0 || last_off <= UINT32_MAX )
+      break;
+    if ( sorted ) {
+      fprintf(stderr, "members beyond 4 GiB, writing an unsorted index\n");
+      sorted = false;
+      continue;
+    }
+    if ( word == 8 )
+      break;
+    word = 8;
+  }
+
+  size_t sym = 0;
+  for (size_t i = 0; i < num_ins && syms_offs_len; i ++)
+    for (size_t o = 0; o < in_syms[i].count; o ++)
+      put_be(syms_offs + word * sym ++, member_offs[i], word);
+
+  File_presize(outf, pos);
+
+  if ( syms_offs_len > 0 )
+  {
+    Ar_FileHeader header;
+    init_ar_header(&header, true);
+    no_nt_strcpy(header.filename, sorted ? "#1/20" : word == 8 ? "/SYM64/" : "/");
+    char _filesize[21];
+    sprintf(_filesize, "%zu", (sorted ? BSD_SYMDEF_NAME_LEN : 0) + syms_size);
+    no_nt_strcpy(header.decimal_file_size, _filesize);
+
+    fwrite(&header, 1, sizeof(header), outf);
+
+    if (sorted)
+    {
+      fwrite(BSD_SYMDEF_NAME, 1, BSD_SYMDEF_NAME_LEN, outf);
+
+      uint8_t* buf = malloc(syms_size);
+      if (buf && !fill_sorted_index(buf, syms, member_offs, num_ins))
+        fwrite(buf, 1, syms_size, outf);
+      else {
+        fprintf(stderr, "out of memory\n");
+        code = 1;
+      }
+      free(buf);
+      pad_member(outf, BSD_SYMDEF_NAME_LEN + syms_size);
+    }
+    else
+    {
+      uint8_t num_ents[8];
+      put_be(num_ents, syms_offs_len, word);
+      fwrite(num_ents, 1, word, outf);
+
+      fwrite(syms_offs, 1, syms_offs_len * word, outf);
+      fwrite(syms_names, 1, syms_names_len, outf);
+      pad_member(outf, syms_size);
+    }
+  }
+  free(syms_names);
+  for (size_t i = 0; i < num_ins; i ++)
+    free(in_syms[i].names);
+
+  if (!sorted)
+  {
+    Ar_FileHeader header;
+    init_ar_header(&header, true);
+    no_nt_strcpy(header.filename, "//");
+    char _filesize[20];
+    sprintf(_filesize, "%zu", filenames_len);
+    no_nt_strcpy(header.decimal_file_size, _filesize);
+
+    fwrite(&header, 1, sizeof(header), outf);
+    fwrite(filenames, 1, filenames_len, outf);
+    pad_member(outf, filenames_len);
+  }
+
+  if (manifest)
+    write_manifest(outf, manifest, manifest_len, manifest_reserved);
+
+
+  for (size_t i = 0; i < num_ins; i ++)
+  {
+    FILE* infile = handles[i];
+    if (infile == NULL) continue;
+
+    // BSD: "#1/<name length>", the name is stored in front of the data
+    size_t name_len = name_stored[i];
+    Ar_FileHeader header;
+    init_ar_header(&header, false);
+    char _filename[20];
+    sprintf(_filename, sorted ? "#1/%zu" : "/%zu", sorted ? name_len : fnidc[i]);
+    no_nt_strcpy(header.filename, _filename);
+    char _filesize[21];
+    sprintf(_filesize, "%llu", (unsigned long long) (name_len + filesizes[i]));
+    no_nt_strcpy(header.decimal_file_size, _filesize);
+
+    fseeko(outf, member_offs[i], SEEK_SET);
+    fwrite(&header, 1, sizeof(header), outf);
+    fwrite(filenames + fnidc[i], 1, sorted ? fnlens[i] : 0, outf);
+    for (size_t z = sorted ? fnlens[i] : 0; z < name_len; z ++)
+      fputc('\0', outf);
+    if (thin) continue;
+
+    uint64_t data_off = member_offs[i] + sizeof(header) + name_len;
+    if ( File_copyRange(outf, data_off, infile, 0, filesizes[i]) ) {
+      fprintf(stderr, "could not copy %s\n", ins[i]);
+      code = 1;
+    }
+
+    fseeko(outf, data_off + filesizes[i], SEEK_SET);
+    pad_member(outf, name_len + filesizes[i]);
+  }
+
+  free(filenames);
+
+  free(syms_offs);
+
+  for (size_t i = 0; i < num_ins; i ++) {
+    if (handles[i])
+      fclose(handles[i]);
+  }
+
+  fclose(outf);
+
+  return code;
+}
+
+/*
+ * r, q and d edit an existing archive.
+ *
+ * archives written by them reserve some room in the symbol index and the
+ * name table. as long as a change fits into that room, only the members
+ * after the first changed one are written again (for q: only the new ones).
+ * the symbol index is rebuilt from the old index; only new members are parsed.
+ */
+
+typedef struct {
+  char* name;
+  /** header offset in the archive that was read; 0 for new members */
+  uint64_t old_off;
+  /** bytes after the header in the old archive, BSD names included; 0 for thin members */
+  uint64_t old_stored;
+  uint64_t old_data_off;
+  Ar_FileHeader old_hdr;
+  /** new members only */
+  char const* path;
+  FILE* handle;
+  size_t name_off /** in the name table, if the name does not fit the header */;
+  size_t name_stored /** BSD name in front of the data, with its padding; see ar_edit_layout */;
+  uint64_t size;
+  ArInputSyms syms;
+  bool deleted;
+} ArEnt;
+
+typedef struct {
+  ArEnt* ents;
+  size_t len, cap;
+
+  bool exists;
+  bool thin;
+  /**
+   * "/" or "/SYM64/", then "//", then the members; anything else
+   * (BSD index, ...) is always rewritten completely
+   */
+  bool simple;
+  /** of the existing symbol index, 0 = none */
+  size_t index_word;
+  /** the existing index is a "__.SYMDEF SORTED" one */
+  bool index_sorted;
+  /** the index that is written; see fill_sorted_index. also means BSD member names */
+  bool sorted;
+  uint64_t index_data_off;
+  uint64_t index_reserved;
+  bool has_names;
+  uint64_t names_data_off;
+  uint64_t names_reserved;
+  /** new names are only appended, so "/<offset>" headers of old members stay valid */
+  char* names;
+  size_t names_len, names_cap;
+  bool has_manifest;
+  uint64_t manifest_data_off;
+  uint64_t manifest_reserved;
+  /**
+   * what the manifest is replaced with, see ar_hashed; NULL = none.
+   * any other edit makes the old one empty, so it no longer matches the members
+   */
+  char const* manifest;
+  size_t manifest_len;
+  uint64_t data_start;
+} ArEdit;
+
+typedef struct {
+  char const* name;
+  size_t idx;
+} ArNameRef;
+
+static uint64_t hdr_size(Ar_FileHeader const* hd)
+{
+  char tmp[11];
+  memcpy(tmp, hd->decimal_file_size, 10);
+  tmp[10] = '\0';
+  return strtoull(tmp, NULL, 10);
+}
+
+static void hdr_set(Ar_FileHeader* hd, char const* name, uint64_t size)
+{
+  memset(hd->filename, ' ', 16);
+  no_nt_strcpy(hd->filename, name);
+  char _filesize[21];
+  sprintf(_filesize, "%llu", (unsigned long long) size);
+  memset(hd->decimal_file_size, ' ', 10);
+  no_nt_strcpy(hd->decimal_file_size, _filesize);
+}
+
+static bool is_thin_hdr(bool thin, Ar_FileHeader const* hd)
+{
+  return thin && hd->filename[0] == '/' && hd->filename[1] >= '0' && hd->filename[1] <= '9';
+}
+
+static bool ar_needs_name_table(ArEdit const* ed, char const* name)
+{
+  if ( ed->sorted )
+    return false;
+  // thin members are always "/<offset>"
+  return ed->thin || strlen(name) > 15;
+}
+
+/** stored bytes after the header of [e]; [raw] keeps old members exactly as they are */
+static uint64_t ar_stored(ArEdit const* ed, ArEnt const* e, bool raw)
+{
+  if (ed->thin)
+    return 0;
+  return e->old_off && raw ? e->old_stored : e->name_stored + e->size;
+}
+
+/** 0 = ok */
+static int ar_edit_push(ArEdit* ed, ArEnt const* ent)
+{
+  if (ed->len == ed->cap) {
+    size_t cap = ed->cap ? ed->cap * 2 : 64;
+    ArEnt* n = realloc(ed->ents, cap * sizeof(ArEnt));
+    if (!n)
+      return 1;
+    ed->ents = n;
+    ed->cap = cap;
+  }
+  ed->ents[ed->len ++] = *ent;
+  return 0;
+}
+
+/** 0 = ok */
+static int ar_edit_add_name(ArEdit* ed, char const* name, size_t* off)
+{
+  size_t len = strlen(name);
+  if (ed->names_len + len + 2 > ed->names_cap) {
+    size_t cap = ed->names_cap ? ed->names_cap * 2 : 256;
+    while (cap < ed->names_len + len + 2)
+      cap *= 2;
+    char* n = realloc(ed->names, cap);
+    if (!n)
+      return 1;
+    ed->names = n;
+    ed->names_cap = cap;
+  }
+  *off = ed->names_len;
+  memcpy(ed->names + ed->names_len, name, len);
+  ed->names_len += len;
+  ed->names[ed->names_len ++] = '/';
+  ed->names[ed->names_len ++] = '\n';
+  return 0;
+}
+
+static int ent_by_old_off(void const* key, void const* ent)
+{
+  uint64_t k = *(uint64_t const*) key;
+  uint64_t o = ((ArEnt const*) ent)->old_off;
+  return k < o ? -1 : k > o;
+}
+
+/** 0 = ok */
+static int ar_edit_load(ArEdit* ed, FILE* file, char const* path, bool want_index)
+{
+  MappedArchive m;
+  if ( MappedArchive_open(&m, file) )
+    return 1;
+  MappedArchive_setPath(&m, path);
+
+  ed->exists = true;
+  ed->thin = m.thin;
+  ed->simple = true;
+  uint8_t const* base = m.map.data;
+
+  // leading symbol index and name table
+  uint64_t pos = 8;
+  while ( pos + sizeof(Ar_FileHeader) <= m.map.size )
+  {
+    Ar_FileHeader const* hd = (Ar_FileHeader const*) (base + pos);
+    uint64_t size = hdr_size(hd);
+    if ( size > m.map.size - pos - sizeof(Ar_FileHeader) )
+      break;
+
+    bool first = pos == 8;
+    if ( first && !memcmp(hd->filename, "/               ", 16) )
+      ed->index_word = 4;
+    else if ( first && !memcmp(hd->filename, "/SYM64/         ", 16) )
+      ed->index_word = 8;
+    else if ( first && !memcmp(hd->filename, "#1/20           ", 16) && size >= BSD_SYMDEF_NAME_LEN &&
+              !memcmp(hd + 1, BSD_SYMDEF_NAME, BSD_SYMDEF_NAME_LEN) ) {
+      ed->index_word = 4;
+      ed->index_sorted = true;
+    }
+    else if ( first && !memcmp(hd->filename, "__.SYMDEF", 9) ) {
+      // unsorted BSD index: replaced by a GNU one
+      ed->index_word = 4;
+      ed->simple = false;
+    }
+    else if ( !ed->has_manifest && !memcmp(hd->filename, AR_MANIFEST_NAME "/     ", 16) )
+    {
+      ed->has_manifest = true;
+      ed->manifest_data_off = pos + sizeof(Ar_FileHeader);
+      ed->manifest_reserved = size;
+    }
+    else if ( !ed->has_names && !memcmp(hd->filename, "//              ", 16) )
+    {
+      ed->has_names = true;
+      ed->names_data_off = pos + sizeof(Ar_FileHeader);
+      ed->names_reserved = size;
+
+      // the reserved room at the end is filled with '\n'
+      char const* tab = (char const*) (hd + 1);
+      size_t len = size;
+      while ( len && tab[len - 1] == '\n' && (len < 2 || tab[len - 2] != '/') )
+        len --;
+      ed->names = malloc(len ? len : 1);
+      if ( !ed->names ) {
+        MappedArchive_close(&m);
+        return 1;
+      }
+      memcpy(ed->names, tab, len);
+      ed->names_len = ed->names_cap = len;
+    }
+    else
+      break;
+
+    if ( first && ed->index_word ) {
+      uint64_t name = ed->index_sorted ? BSD_SYMDEF_NAME_LEN : 0;
+      ed->index_data_off = pos + sizeof(Ar_FileHeader) + name;
+      ed->index_reserved = size - name;
+    }
+    pos += sizeof(Ar_FileHeader) + size + (size & 1);
+  }
+  ed->data_start = pos;
+  // an existing index is always kept up to date
+  want_index = want_index || ed->index_word;
+
+  // the old index is the symbol cache
+  ArSymIndex idx = {0};
+  bool have_syms = false;
+  if ( want_index && ed->index_word )
+  {
+    SmartArchive sa;
+    if ( !SmartArchive_open(&sa, file) ) {
+      have_syms = !SmartArchive_readSymIndex(&idx, &sa) && idx.syms_len;
+      SmartArchive_close(&sa);
+    }
+  }
+
+  int err = 0;
+  ArMemberView v;
+  uint64_t expect = ed->data_start;
+  while ( !err && MappedArchive_next(&m, &v) )
+  {
+    Ar_FileHeader const* hd = (Ar_FileHeader const*) (base + v.offset);
+    bool thin = is_thin_hdr(ed->thin, hd);
+
+    ArEnt e;
+    memset(&e, 0, sizeof(e));
+    e.name = strndup(v.name, v.nameLen);
+    e.old_off = v.offset;
+    e.old_hdr = *hd;
+    e.old_stored = thin ? 0 : hdr_size(hd);
+    e.size = thin ? hdr_size(hd) : v.size;
+    e.old_data_off = thin ? 0 : (uint64_t) (v.data - base);
+    if ( !e.name || ar_edit_push(ed, &e) ) {
+      free(e.name);
+      err = 1;
+      break;
+    }
+
+    // meta members between the others can not be kept in place
+    if ( v.offset != expect )
+      ed->simple = false;
+    expect = v.offset + sizeof(Ar_FileHeader) + e.old_stored + (e.old_stored & 1);
+
+    // no usable index: this is the only time old members are parsed
+    if ( want_index && !have_syms && v.data && v.size )
+    {
+      FILE* f = memFileOpenReadOnly((void*) v.data, v.size);
+      if ( f ) {
+        arCollectFile(&ed->ents[ed->len - 1].syms, f);
+        fclose(f);
+      }
+    }
+  }
+  if ( expect != m.map.size )
+    ed->simple = false;
+
+  for ( size_t i = 0; have_syms && !err && i < idx.syms_len; i ++ )
+  {
+    ArSym const* sym = &idx.syms[i];
+    ArEnt* e = bsearch(&sym->offset, ed->ents, ed->len, sizeof(ArEnt), ent_by_old_off);
+    if ( e )
+      err = arSymsAppend(&e->syms, sym->name, strlen(sym->name));
+  }
+
+  ArSymIndex_free(&idx);
+  MappedArchive_close(&m);
+  return err;
+}
+
+static int name_ref_cmp(void const* a, void const* b)
+{
+  ArNameRef const* x = a;
+  ArNameRef const* y = b;
+  int c = strcmp(x->name, y->name);
+  if ( c )
+    return c;
+  return x->idx < y->idx ? -1 : x->idx > y->idx;
+}
+
+/** first member called [name] that is not deleted yet; NULL if none */
+static ArEnt* ar_edit_find(ArEdit* ed, ArNameRef const* refs, size_t nrefs, char const* name)
+{
+  size_t lo = 0, hi = nrefs;
+  while ( lo < hi ) {
+    size_t mid = lo + (hi - lo) / 2;
+    if ( strcmp(refs[mid].name, name) < 0 )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for ( ; lo < nrefs && !strcmp(refs[lo].name, name); lo ++ )
+    if ( !ed->ents[refs[lo].idx].deleted )
+      return &ed->ents[refs[lo].idx];
+  return NULL;
+}
+
+/** offset of every member that is not deleted; returns the end of the archive */
+static uint64_t ar_edit_layout(ArEdit* ed, uint64_t start, bool raw, uint64_t* offs, uint64_t* last_off)
+{
+  uint64_t pos = start;
+  *last_off = 0;
+  for ( size_t i = 0; i < ed->len; i ++ )
+  {
+    ArEnt* e = &ed->ents[i];
+    if ( e->deleted ) continue;
+    offs[i] = *last_off = pos;
+    // same padding as gen_ar: the data starts 8 byte aligned
+    size_t len = strlen(e->name);
+    e->name_stored = ed->sorted ? len + (8 - (pos + sizeof(Ar_FileHeader) + len) % 8) % 8 : 0;
+    uint64_t stored = ar_stored(ed, e, raw);
+    pos += sizeof(Ar_FileHeader) + stored + (stored & 1);
+  }
+  return pos;
+}
+
+static uint64_t ar_edit_index_size(ArEdit const* ed, size_t word, size_t* count)
+{
+  uint64_t bytes = 0;
+  *count = 0;
+  for ( size_t i = 0; i < ed->len; i ++ )
+  {
+    if ( ed->ents[i].deleted ) continue;
+    *count += ed->ents[i].syms.count;
+    bytes += ed->ents[i].syms.names_len;
+  }
+  if ( ed->sorted )
+    return 8 + 8 * *count + bytes;
+  return word + word * *count + bytes;
+}
+
+/** [buf] has to be [size] bytes; everything after the index is zeroed */
+static int ar_edit_fill_index(uint8_t* buf, uint64_t size, ArEdit const* ed, uint64_t const* offs, size_t word)
+{
+  size_t count;
+  ar_edit_index_size(ed, word, &count);
+  memset(buf, 0, size);
+
+  if ( ed->sorted )
+  {
+    ArInputSyms const* syms[ed->len];
+    for ( size_t i = 0; i < ed->len; i ++ )
+      syms[i] = ed->ents[i].deleted ? NULL : &ed->ents[i].syms;
+    if ( sorted_index_size(syms, ed->len) > size )
+      return 1;
+    return fill_sorted_index(buf, syms, offs, ed->len);
+  }
+
+  put_be(buf, count, word);
+
+  uint8_t* off = buf + word;
+  char* names = (char*) buf + word + word * count;
+  for ( size_t i = 0; i < ed->len; i ++ )
+  {
+    ArEnt const* e = &ed->ents[i];
+    if ( e->deleted ) continue;
+    for ( size_t s = 0; s < e->syms.count; s ++, off += word )
+      put_be(off, offs[i], word);
+    if ( e->syms.names_len )
+      memcpy(names, e->syms.names, e->syms.names_len);
+    names += e->syms.names_len;
+  }
+  return 0;
+}
+
+/** header of a member that is (re)written; not for raw copies */
+static void ar_edit_header(Ar_FileHeader* hd, ArEdit const* ed, ArEnt const* e)
+{
+  if ( e->old_off )
+    *hd = e->old_hdr;
+  else
+    init_ar_header(hd, false);
+
+  char field[24];
+  if ( ed->sorted )
+    sprintf(field, "#1/%zu", e->name_stored);
+  else if ( ar_needs_name_table(ed, e->name) )
+    sprintf(field, "/%zu", e->name_off);
+  else
+    sprintf(field, "%s/", e->name);
+  hdr_set(hd, field, e->name_stored + e->size);
+}
+
+/**
+ * writes members [from, len) to [dst] at their offset minus [base].
+ * [raw] copies old members as they are, including their header
+ * 0 = ok
+ */
+static int ar_edit_write_members(FILE* dst, uint64_t base, ArEdit const* ed, size_t from,
+                                 uint64_t const* offs, FILE* old, bool raw)
+{
+  int err = 0;
+  for ( size_t i = from; i < ed->len && !err; i ++ )
+  {
+    ArEnt const* e = &ed->ents[i];
+    if ( e->deleted ) continue;
+    uint64_t at = offs[i] - base;
+    uint64_t stored = ar_stored(ed, e, raw);
+
+    if ( e->old_off && raw )
+    {
+      err = File_copyRange(dst, at, old, e->old_off, sizeof(Ar_FileHeader) + stored);
+    }
+    else
+    {
+      Ar_FileHeader header;
+      ar_edit_header(&header, ed, e);
+      fseeko(dst, at, SEEK_SET);
+      fwrite(&header, 1, sizeof(header), dst);
+
+      size_t len = e->name_stored ? strlen(e->name) : 0;
+      fwrite(e->name, 1, len, dst);
+      for ( size_t z = len; z < e->name_stored; z ++ )
+        fputc('\0', dst);
+
+      // thin archives only have the header
+      uint64_t data = at + sizeof(header) + e->name_stored;
+      if ( !ed->thin && e->old_off )
+        err = File_copyRange(dst, data, old, e->old_data_off, e->size);
+      else if ( !ed->thin )
+        err = File_copyRange(dst, data, e->handle, 0, e->size);
+    }
+
+    fseeko(dst, at + sizeof(Ar_FileHeader) + stored, SEEK_SET);
+    pad_member(dst, stored);
+  }
+  return err;
+}
+
+/** only rewrites what changed; false if the archive has to be rewritten completely */
+static bool ar_edit_in_place(ArEdit* ed, FILE* file, bool want_index, int* code)
+{
+  // a new index or manifest needs room in front of the members
+  if ( !ed->exists || !ed->simple || (want_index && !ed->index_word) )
+    return false;
+  if ( ed->manifest && (!ed->has_manifest || ed->manifest_len > ed->manifest_reserved) )
+    return false;
+
+  // new names only go into the room that the name table has left
+  for ( size_t i = 0; i < ed->len; i ++ )
+  {
+    ArEnt* e = &ed->ents[i];
+    if ( !e->deleted && !e->old_off && ar_needs_name_table(ed, e->name) &&
+         ar_edit_add_name(ed, e->name, &e->name_off) )
+      return false;
+  }
+  if ( ed->names_len > (ed->has_names ? ed->names_reserved : 0) )
+    return false;
+
+  uint64_t offs[ed->len];
+  uint64_t last_off;
+  uint64_t end = ar_edit_layout(ed, ed->data_start, true, offs, &last_off);
+
+  size_t word = last_off > UINT32_MAX ? 8 : 4;
+  uint64_t index_size = 0;
+  if ( ed->index_word )
+  {
+    size_t count;
+    index_size = ar_edit_index_size(ed, word, &count);
+    if ( word != ed->index_word || ed->sorted != ed->index_sorted ||
+         index_size > ed->index_reserved )
+      return false;
+  }
+
+  // everything up to the first change stays where it is
+  size_t k = 0;
+  uint64_t tail = ed->data_start;
+  for ( ; k < ed->len; k ++ )
+  {
+    ArEnt const* e = &ed->ents[k];
+    if ( e->deleted || !e->old_off || e->old_off != offs[k] )
+      break;
+    tail = offs[k] + sizeof(Ar_FileHeader) + e->old_stored + (e->old_stored & 1);
+  }
+
+  // members that move back can be copied in place, front to back
+  bool forward = false;
+  for ( size_t i = k; i < ed->len; i ++ )
+  {
+    ArEnt const* e = &ed->ents[i];
+    if ( e->deleted || !e->old_off ) continue;
+    if ( offs[i] > e->old_off )
+      forward = true;
+    // a raw copy keeps the BSD name padding, which only aligns the data for the old offset
+    if ( ed->sorted && (e->old_off - offs[i]) % 8 )
+      return false;
+  }
+
+  int err;
+  if ( !forward )
+  {
+    err = ar_edit_write_members(file, 0, ed, k, offs, file, true);
+  }
+  else
+  {
+    FILE* tmp = tmpfile();
+    if ( !tmp )
+      return false;
+    err = ar_edit_write_members(tmp, tail, ed, k, offs, file, true);
+    if ( !err )
+      err = File_copyRange(file, tail, tmp, 0, end - tail);
+    fclose(tmp);
+  }
+
+  if ( !err && ed->index_word )
+  {
+    uint8_t* buf = malloc(ed->index_reserved);
+    err = !buf || ar_edit_fill_index(buf, ed->index_reserved, ed, offs, word);
+    if ( !err ) {
+      fseeko(file, ed->index_data_off, SEEK_SET);
+      fwrite(buf, 1, ed->index_reserved, file);
+    }
+    free(buf);
+  }
+
+  if ( !err && ed->has_names )
+  {
+    fseeko(file, ed->names_data_off, SEEK_SET);
+    fwrite(ed->names, 1, ed->names_len, file);
+    for ( uint64_t i = ed->names_len; i < ed->names_reserved; i ++ )
+      fputc('\n', file);
+  }
+
+  if ( !err && ed->has_manifest )
+  {
+    size_t len = ed->manifest ? ed->manifest_len : 0;
+    fseeko(file, ed->manifest_data_off, SEEK_SET);
+    fwrite(ed->manifest, 1, len, file);
+    for ( uint64_t i = len; i < ed->manifest_reserved; i ++ )
+      fputc('\n', file);
+  }
+
+  if ( !err )
+    err = File_presize(file, end);
+
+  if ( err || fflush(file) ) {
+    fprintf(stderr, "error while updating the archive, it might be damaged\n");
+    *code = 1;
+  }
+  return true;
+}
+
+/** writes a new archive next to the old one and replaces it; 0 = ok */
+static int ar_edit_rewrite(ArEdit* ed, char const* archive, FILE* old, bool want_index)
+{
+  // the name table is built again, without the names of deleted members
+  ed->names_len = 0;
+  for ( size_t i = 0; i < ed->len; i ++ )
+  {
+    ArEnt* e = &ed->ents[i];
+    if ( !e->deleted && ar_needs_name_table(ed, e->name) &&
+         ar_edit_add_name(ed, e->name, &e->name_off) )
+      return 1;
+  }
+  uint64_t names_reserved = ed->names_len ? ar_reserve(ed->names_len) : 0;
+
+  uint64_t offs[ed->len];
+  uint64_t last_off, end, index_reserved = 0;
+  size_t word = 4;
+  for (;;)
+  {
+    uint64_t start = 8;
+    if ( want_index ) {
+      size_t count;
+      index_reserved = ar_reserve(ar_edit_index_size(ed, word, &count));
+      start += sizeof(Ar_FileHeader) + (ed->sorted ? BSD_SYMDEF_NAME_LEN : 0) + index_reserved;
+    }
+    if ( names_reserved )
+      start += sizeof(Ar_FileHeader) + names_reserved;
+    if ( ed->manifest )
+      start += sizeof(Ar_FileHeader) + ar_reserve(ed->manifest_len);
+
+    end = ar_edit_layout(ed, start, false, offs, &last_off);
+    if ( !want_index || last_off <= UINT32_MAX )
+      break;
+    if ( ed->sorted ) {
+      // the BSD names are gone as well, so they go into a name table again
+      fprintf(stderr, "members beyond 4 GiB, writing an unsorted index\n");
+      ed->sorted = false;
+      for ( size_t i = 0; i < ed->len; i ++ )
+      {
+        ArEnt* e = &ed->ents[i];
+        if ( !e->deleted && ar_needs_name_table(ed, e->name) &&
+             ar_edit_add_name(ed, e->name, &e->name_off) )
+          return 1;
+      }
+      names_reserved = ed->names_len ? ar_reserve(ed->names_len) : 0;
+      continue;
+    }
+    if ( word == 8 )
+      break;
+    word = 8;
+  }
+
+  size_t tmplen = strlen(archive) + 5;
+  char tmpname[tmplen];
+  snprintf(tmpname, tmplen, "%s.tmp", archive);
+  FILE* out = fopen(tmpname, "wb");
+  if ( !out )
+    return 1;
+
+  fwrite(ed->thin ? "!<thin>\x0A" : "!<arch>\x0A", 1, 8, out);
+  File_presize(out, end);
+
+  int err = 0;
+  if ( want_index )
+  {
+    Ar_FileHeader header;
+    init_ar_header(&header, true);
+    if ( ed->sorted ) {
+      hdr_set(&header, "#1/20", BSD_SYMDEF_NAME_LEN + index_reserved);
+      fwrite(&header, 1, sizeof(header), out);
+      fwrite(BSD_SYMDEF_NAME, 1, BSD_SYMDEF_NAME_LEN, out);
+    } else {
+      hdr_set(&header, word == 8 ? "/SYM64/" : "/", index_reserved);
+      fwrite(&header, 1, sizeof(header), out);
+    }
+
+    uint8_t* buf = malloc(index_reserved);
+    err = !buf || ar_edit_fill_index(buf, index_reserved, ed, offs, word);
+    if ( !err )
+      fwrite(buf, 1, index_reserved, out);
+    free(buf);
+  }
+
+  if ( names_reserved )
+  {
+    Ar_FileHeader header;
+    init_ar_header(&header, true);
+    hdr_set(&header, "//", names_reserved);
+    fwrite(&header, 1, sizeof(header), out);
+    fwrite(ed->names, 1, ed->names_len, out);
+    for ( uint64_t i = ed->names_len; i < names_reserved; i ++ )
+      fputc('\n', out);
+  }
+
+  if ( ed->manifest )
+    write_manifest(out, ed->manifest, ed->manifest_len, ar_reserve(ed->manifest_len));
+
+  if ( !err )
+    err = ar_edit_write_members(out, 0, ed, 0, offs, old, false);
+
+  if ( fclose(out) || err || rename(tmpname, archive) ) {
+    remove(tmpname);
+    return 1;
+  }
+  return 0;
+}
+
+/** r, q and d; [mods] are the letters after the command */
+static int ar_edit(char mode, char const* mods, char const* archive, char** args, size_t nargs,
+                   char const* manifest)
+{
+  bool want_index = strchr(mods, 's') || strchr(mods, 'B');
+
+  ArEdit ed;
+  memset(&ed, 0, sizeof(ed));
+  ed.thin = strchr(mods, 'T');
+  ed.manifest = manifest;
+  ed.manifest_len = manifest ? strlen(manifest) : 0;
+
+  FILE* file = fopen(archive, "r+b");
+  if ( file ) {
+    if ( ar_edit_load(&ed, file, archive, want_index) ) {
+      fprintf(stderr, "error reading archive\n");
+      fclose(file);
+      return 1;
+    }
+  } else if ( mode == 'd' ) {
+    fprintf(stderr, "could not open file\n");
+    return 1;
+  } else if ( !strchr(mods, 'c') ) {
+    fprintf(stderr, "creating %s\n", archive);
+  }
+  want_index = want_index || ed.index_word;
+  // B asks for a sorted index, an existing one stays sorted
+  ed.sorted = strchr(mods, 'B') || ed.index_sorted;
+  want_index = want_index || ed.sorted;
+  if ( ed.sorted && ed.thin ) {
+    fprintf(stderr, "thin archives can not have a BSD index\n");
+    if ( file )
+      fclose(file);
+    return 1;
+  }
+
+  int code = 0;
+  size_t nrefs = ed.len;
+  ArNameRef* refs = malloc(sizeof(ArNameRef) * (nrefs ? nrefs : 1));
+  if ( !refs ) {
+    fprintf(stderr, "out of memory\n");
+    code = 1;
+    nargs = 0;
+  }
+  for ( size_t i = 0; i < nrefs && refs; i ++ )
+    refs[i] = (ArNameRef) { ed.ents[i].name, i };
+  if ( refs )
+    qsort(refs, nrefs, sizeof(ArNameRef), name_ref_cmp);
+
+  for ( size_t a = 0; a < nargs && !code; a ++ )
+  {
+    if ( mode == 'd' ) {
+      ArEnt* e = ar_edit_find(&ed, refs, nrefs, args[a]);
+      if ( e )
+        e->deleted = true;
+      else
+        fprintf(stderr, "no entry %s in archive\n", args[a]);
+      continue;
+    }
+
+    char* name = member_name(archive, args[a], ed.thin);
+    ArEnt* e = mode == 'r' && name ? ar_edit_find(&ed, refs, nrefs, name) : NULL;
+    if ( e ) {
+      // replaced in place: the member keeps its position
+      free(name);
+      free(e->syms.names);
+      memset(&e->syms, 0, sizeof(e->syms));
+      e->old_off = 0;
+      e->old_stored = 0;
+      e->path = args[a];
+    } else {
+      ArEnt n;
+      memset(&n, 0, sizeof(n));
+      n.name = name;
+      n.path = args[a];
+      if ( !name || ar_edit_push(&ed, &n) ) {
+        free(name);
+        fprintf(stderr, "out of memory\n");
+        code = 1;
+      }
+    }
+  }
+  free(refs);
+
+  // new members: open them all first, so nothing is changed if one is missing
+  size_t nnew = 0;
+  for ( size_t i = 0; i < ed.len; i ++ )
+    if ( ed.ents[i].path && !ed.ents[i].deleted )
+      nnew ++;
+
+  FILE* handles[nnew ? nnew : 1];
+  ArInputSyms new_syms[nnew ? nnew : 1];
+  memset(new_syms, 0, sizeof(new_syms));
+  size_t n = 0;
+  for ( size_t i = 0; i < ed.len && !code; i ++ )
+  {
+    ArEnt* e = &ed.ents[i];
+    if ( !e->path || e->deleted ) continue;
+    e->handle = handles[n ++] = fopen(e->path, "rb");
+    if ( !e->handle ) {
+      fprintf(stderr, "Can't open %s\n", e->path);
+      code = 1;
+      break;
+    }
+    fseeko(e->handle, 0, SEEK_END);
+    e->size = ftello(e->handle);
+    if ( e->size > AR_MAX_MEMBER_SIZE ) {
+      fprintf(stderr, "%s is too big for an archive member\n", e->path);
+      code = 1;
+    }
+  }
+
+  if ( !code && want_index && nnew )
+  {
+    ArSymJob job = { handles, new_syms };
+    Parallel_for(nnew, 0, arCollectSyms, &job);
+
+    n = 0;
+    for ( size_t i = 0; i < ed.len; i ++ )
+      if ( ed.ents[i].path && !ed.ents[i].deleted ) {
+        if ( new_syms[n].failed )
+          printf("could not generate symbol indexes for %s\n", ed.ents[i].path);
+        ed.ents[i].syms = new_syms[n ++];
+      }
+  }
+
+  if ( !code && !ar_edit_in_place(&ed, file, want_index, &code) &&
+       ar_edit_rewrite(&ed, archive, file, want_index) )
+  {
+    fprintf(stderr, "Can't write %s\n", archive);
+    code = 1;
+  }
+
+  for ( size_t i = 0; i < ed.len; i ++ )
+  {
+    if ( ed.ents[i].handle )
+      fclose(ed.ents[i].handle);
+    free(ed.ents[i].syms.names);
+    free(ed.ents[i].name);
+  }
+  free(ed.ents);
+  free(ed.names);
+  if ( file )
+    fclose(file);
+  return code;
+}
+
+/** FNV-1a over 8 byte words, the tail byte wise; only has to notice changes */
+static uint64_t ar_hash_data(uint8_t const* data, size_t len)
+{
+  uint64_t h = 0xcbf29ce484222325ull;
+  size_t i = 0;
+  for ( ; i + 8 <= len; i += 8 )
+  {
+    uint64_t w;
+    memcpy(&w, data + i, 8);
+    h = (h ^ w) * 0x100000001b3ull;
+  }
+  for ( ; i < len; i ++ )
+    h = (h ^ data[i]) * 0x100000001b3ull;
+  return h;
+}
+
+typedef struct {
+  char** paths;
+  uint64_t* hashes;
+  uint64_t* sizes;
+  bool* failed;
+} ArHashJob;
+
+static void arHashInput(void* ctx, size_t i)
+{
+  ArHashJob* job = ctx;
+  job->failed[i] = true;
+  FILE* f = fopen(job->paths[i], "rb");
+  if ( !f ) return;
+  MappedFile map;
+  if ( !MappedFile_open(&map, f) )
+  {
+    job->hashes[i] = ar_hash_data(map.data, map.size);
+    job->sizes[i] = map.size;
+    job->failed[i] = false;
+    MappedFile_close(&map);
+  }
+  fclose(f);
+}
+
+/**
+ * the manifest of [archive] without the '\n' fill behind it, heap;
+ * NULL if there is none. only the meta members in front of the first file are looked at
+ */
+static char* ar_read_manifest(char const* archive)
+{
+  FILE* f = fopen(archive, "rb");
+  if ( !f ) return NULL;
+  MappedFile map;
+  if ( MappedFile_open(&map, f) ) {
+    fclose(f);
+    return NULL;
+  }
+
+  char* res = NULL;
+  uint8_t const* data = map.data;
+  uint64_t pos = 8;
+  while ( !res && map.size >= 8 && !memcmp(data, "!<arch>\n", 8) &&
+          pos + sizeof(Ar_FileHeader) <= map.size )
+  {
+    Ar_FileHeader const* hd = (Ar_FileHeader const*) (data + pos);
+    uint64_t start = pos + sizeof(Ar_FileHeader);
+    uint64_t size = hdr_size(hd);
+    if ( size > map.size - start )
+      break;
+
+    if ( !memcmp(hd->filename, AR_MANIFEST_NAME "/     ", 16) )
+    {
+      size_t len = size;
+      while ( len && data[start + len - 1] == '\n' )
+        len --;
+      // every line ends with a '\n'
+      if ( len && len < size )
+        len ++;
+      res = malloc(len + 1);
+      if ( !res ) break;
+      memcpy(res, data + start, len);
+      res[len] = '\0';
+    }
+    else if ( (hd->filename[0] == '/' && !(hd->filename[1] >= '0' && hd->filename[1] <= '9')) ||
+              !memcmp(hd->filename, "__.SYMDEF", 9) ||
+              (!memcmp(hd->filename, "#1/", 3) && size >= 9 && !memcmp(data + start, "__.SYMDEF", 9)) )
+    {
+      pos = start + size + (size & 1);
+    }
+    else
+      break;
+  }
+
+  MappedFile_close(&map);
+  fclose(f);
+  return res;
+}
+
+/** length of the manifest line at [s] without the '\n'; [name] is set to its last field */
+static size_t ar_manifest_line(char const* s, char const** name)
+{
+  char const* end = strchr(s, '\n');
+  size_t len = end ? (size_t) (end - s) : strlen(s);
+  char const* sp = memchr(s, ' ', len);
+  sp = sp ? memchr(sp + 1, ' ', len - (sp + 1 - s)) : NULL;
+  *name = sp ? sp + 1 : s + len;
+  return len;
+}
+
+/**
+ * rcH: like gen_ar, but remembers a hash of every input in the archive.
+ * if no input changed, the archive is not touched at all;
+ * if only some did, just those members are replaced (see ar_edit)
+ */
+static int ar_hashed(char* out, char** ins, size_t num_ins, bool ranlib, bool sorted)
+{
+  uint64_t hashes[num_ins ? num_ins : 1];
+  uint64_t sizes[num_ins ? num_ins : 1];
+  bool failed[num_ins ? num_ins : 1];
+  char* names[num_ins ? num_ins : 1];
+
+  ArHashJob job = { ins, hashes, sizes, failed };
+  Parallel_for(num_ins, 0, arHashInput, &job);
+
+  int code = 0;
+  size_t cap = 32;
+  for ( size_t i = 0; i < num_ins; i ++ )
+  {
+    names[i] = member_name(out, ins[i], false);
+    if ( failed[i] ) {
+      fprintf(stderr, "Can't open %s\n", ins[i]);
+      code = 1;
+    }
+    if ( !names[i] )
+      code = 1;
+    else
+      cap += strlen(names[i]) + 48;
+  }
+
+  char* manifest = code ? NULL : malloc(cap);
+  if ( !code && !manifest ) {
+    fprintf(stderr, "out of memory\n");
+    code = 1;
+  }
+
+  size_t len = 0;
+  if ( !code )
+  {
+    len = sprintf(manifest, "ubu-ar-hash 1 %s%s\n", ranlib ? "s" : "", sorted ? "B" : "");
+    for ( size_t i = 0; i < num_ins; i ++ )
+      len += sprintf(manifest + len, "%016llx %llu %s\n", (unsigned long long) hashes[i],
+                     (unsigned long long) sizes[i], names[i]);
+  }
+
+  char* old = code ? NULL : ar_read_manifest(out);
+  if ( old && !strcmp(old, manifest) )
+  {
+    // nothing changed: not even the modification time
+  }
+  else if ( old )
+  {
+    // same members in the same order: only the ones whose hash changed are replaced
+    char* changed[num_ins ? num_ins : 1];
+    size_t nchanged = 0;
+    char const* ol = old;
+    char const* nl = manifest;
+    char const *on, *nn;
+    size_t olen = ar_manifest_line(ol, &on);
+    size_t nlen = ar_manifest_line(nl, &nn);
+    // the first line has the format version and the modifiers
+    bool same = olen == nlen && !memcmp(ol, nl, nlen) && ol[olen];
+    for ( size_t i = 0; i < num_ins && same; i ++ )
+    {
+      ol += olen + 1;
+      nl += nlen + 1;
+      olen = ar_manifest_line(ol, &on);
+      nlen = ar_manifest_line(nl, &nn);
+      same = ol[olen] && olen - (on - ol) == nlen - (nn - nl) && !memcmp(on, nn, nlen - (nn - nl));
+      if ( same && (olen != nlen || memcmp(ol, nl, nlen)) )
+        changed[nchanged ++] = ins[i];
+    }
+    same = same && !ol[olen + 1];
+
+    // names have to be unique, so every input finds its own member
+    char* sorted_names[num_ins ? num_ins : 1];
+    memcpy(sorted_names, names, sizeof(char*) * num_ins);
+    qsort(sorted_names, num_ins, sizeof(char*), str_ptr_cmp);
+    for ( size_t i = 1; i < num_ins && same; i ++ )
+      if ( !strcmp(sorted_names[i - 1], sorted_names[i]) )
+        same = false;
+
+    if ( same )
+      code = ar_edit('r', sorted ? "csB" : ranlib ? "cs" : "c", out, changed, nchanged, manifest);
+    else
+      code = gen_ar(out, ins, num_ins, ranlib, false, sorted, manifest, len);
+  }
+  else if ( !code )
+  {
+    code = gen_ar(out, ins, num_ins, ranlib, false, sorted, manifest, len);
+  }
+
+  free(old);
+  free(manifest);
+  for ( size_t i = 0; i < num_ins; i ++ )
+    free(names[i]);
+  return code;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3) {
+    print_usage();
+    return 1;
+  }
+
+  // rc, rcs, rcT, rcsT, rcsB, rcsH, ...
+  if (argv[1][0] == 'r' && strchr(argv[1], 'c') &&
+      strspn(argv[1], "rcsTBH") == strlen(argv[1])) {
+    bool sorted = strchr(argv[1], 'B');
+    if (sorted && strchr(argv[1], 'T')) {
+      fprintf(stderr, "thin archives can not have a BSD index\n");
+      return 1;
+    }
+    if (strchr(argv[1], 'H')) {
+      // other tools would take the manifest for a member of a thin archive
+      if (strchr(argv[1], 'T')) {
+        fprintf(stderr, "thin archives can not have a hash manifest\n");
+        return 1;
+      }
+      return ar_hashed(argv[2], argv + 3, argc - 3, strchr(argv[1], 's') || sorted, sorted);
+    }
+    return gen_ar(argv[2], argv + 3, argc - 3, strchr(argv[1], 's') || sorted, strchr(argv[1], 'T'), sorted, NULL, 0);
+  }
+
+  char mode = argv[1][0];
+
+  // r, rs, q, qs, qc, d, ds, ...
+  if ( strchr("rqd", mode) && strspn(argv[1] + 1, "csTB") == strlen(argv[1] + 1) )
+    return ar_edit(mode, argv[1] + 1, argv[2], argv + 3, argc - 3, NULL);
+
+  // xo: keep the stored mtime and mode
+  bool keep_meta = mode == 'x' && argv[1][1] == 'o';
+
+  if ( (argv[1][1] && !keep_meta) || (keep_meta && argv[1][2]) || !strchr("txp", mode) ) {
+    print_usage();
+    return 1;
+  }
+
+  FILE* file = fopen(argv[2], "rb");
+  if ( !file ) {
+    fprintf(stderr, "could not open file\n");
+    return 1;
   }
 
   SmartArchive a;
   if ( SmartArchive_open(&a, file) ) {
+    // ALF libraries can only be listed
+    Alf alf;
+    if ( mode == 't' && !Alf_open(&alf, file) ) {
+      arDisplayAlf(&alf);
+      Alf_close(&alf);
+      fclose(file);
+      return 0;
+    }
     fprintf(stderr, "error reading archive\n");
     return 1;
   }
+  SmartArchive_setPath(&a, argv[2]);
 
   int code = 0;
   switch ( mode )
   {
     case 't':
-      arDisplayContents(&a);
+      arDisplayContents(file, argv[2], &code);
       break;
 
     case 'p':
@@ -379,7 +2184,7 @@ int main(int argc, char** argv)
       break;
 
     case 'x':
-      arExtract(&a, argc-3, argv+3, &code);
+      arExtract(&a, file, argc-3, argv+3, keep_meta, &code);
       break;
 
     default:break;
@@ -0,0 +1,114 @@
+#include "ubu/demangle.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool isSymChar(int c)
+{
+  return isalnum(c) || c == '_' || c == '.' || c == '$';
+}
+
+typedef struct {
+  char * buf;
+  size_t len;
+  size_t cap;
+} Word;
+
+static void flushWord(Demangler* d, Word* w)
+{
+  if ( !w->len )
+    return;
+
+  w->buf[w->len] = '\0';
+  char const* dem = Demangler_demangle(d, w->buf);
+  fputs(dem ? dem : w->buf, stdout);
+  w->len = 0;
+}
+
+static int appendWord(Word* w, char const* src, size_t len)
+{
+  if ( w->len + len + 1 > w->cap )
+  {
+    size_t ncap = w->cap ? w->cap : 256;
+    while ( w->len + len + 1 > ncap )
+      ncap *= 2;
+    char * n = realloc(w->buf, ncap);
+    if ( !n )
+      return 1;
+    w->buf = n;
+    w->cap = ncap;
+  }
+  memcpy(w->buf + w->len, src, len);
+  w->len += len;
+  return 0;
+}
+
+/** copies stdin to stdout, demangling every symbol-like word */
+static int filterStream(Demangler* d)
+{
+  static char chunk[64 * 1024];
+  Word word = {0};
+  int code = 0;
+
+  size_t n;
+  while ( (n = fread(chunk, 1, sizeof(chunk), stdin)) > 0 )
+  {
+    size_t i = 0;
+    while ( i < n )
+    {
+      size_t start = i;
+      if ( isSymChar((unsigned char) chunk[i]) )
+      {
+        while ( i < n && isSymChar((unsigned char) chunk[i]) )
+          i ++;
+        if ( appendWord(&word, chunk + start, i - start) )
+        {
+          fprintf(stderr, "out of memory\n");
+          code = 1;
+          goto done;
+        }
+        // the word might continue in the next chunk
+        if ( i < n )
+          flushWord(d, &word);
+      }
+      else
+      {
+        // a word that ended exactly at the end of the previous chunk
+        flushWord(d, &word);
+        while ( i < n && !isSymChar((unsigned char) chunk[i]) )
+          i ++;
+        fwrite(chunk + start, 1, i - start, stdout);
+      }
+    }
+  }
+  flushWord(d, &word);
+
+done:
+  free(word.buf);
+  return code;
+}
+
+int main(int argc, char** argv)
+{
+  Demangler d;
+  Demangler_init(&d);
+
+  int code = 0;
+  if ( argc > 1 )
+  {
+    for ( int i = 1; i < argc; i ++ )
+    {
+      char const* dem = Demangler_demangle(&d, argv[i]);
+      puts(dem ? dem : argv[i]);
+    }
+  }
+  else
+  {
+    code = filterStream(&d);
+  }
+
+  Demangler_free(&d);
+  return code;
+}
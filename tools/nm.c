@@ -3,16 +3,71 @@
 #include "ubu/ar.h"
 #include "ubu/memfile.h"
 #include "ubu/aof.h"
+#include "ubu/alf.h"
+#include "ubu/demangle.h"
+#include "ubu/utils.h"
+#include "ubu/recwriter.h"
 #include <inttypes.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
+typedef struct {
+  size_t ptrstrwidth;
+  /** only symbols with external linkage (-g) */
+  bool extern_only;
+  /** only undefined symbols (-u) */
+  bool undefined_only;
+  /** only symbols that are defined in the file */
+  bool defined_only;
+  /** NULL if names should not be demangled (-C) */
+  Demangler* demangler;
+  /** print the archive symbol index before the members (-s) */
+  bool print_armap;
+  /** only print the archive symbol index; members are never decoded */
+  bool index_only;
+  /** only print the member that defines this symbol, found through the index */
+  char const* lookup;
+  /** NULL for the text output */
+  RecWriter* writer;
+} NmOpts;
+
 static void errclbk(const char * msg) {
   fprintf(stderr, "elf error: %s\n", msg);
 }
 
-static void nmElf(OpElf* elf, size_t ptrstrwidth)
+static char const* symName(char const* name, NmOpts const* opts)
+{
+  if ( opts->demangler ) {
+    char const* dem = Demangler_demangle(opts->demangler, name);
+    if ( dem )
+      return dem;
+  }
+  return name;
+}
+
+static void printValue(uint64_t value, bool has, NmOpts const* opts)
+{
+  if ( has ) {
+    printf("%016" PRIXPTR, (uintptr_t) value);
+  } else {
+    for ( size_t i = 0; i < opts->ptrstrwidth; i ++ )
+      fputc(' ', stdout);
+  }
+}
+
+static void printSym(char const* name, char id, uint64_t value, bool hasValue, NmOpts const* opts)
+{
+  if ( opts->writer ) {
+    RecWriter_sym(opts->writer, name, id, value, hasValue);
+    return;
+  }
+
+  printValue(value, hasValue, opts);
+  printf(" %c %s\n", id, name);
+}
+
+static void nmElf(OpElf* elf, NmOpts const* opts)
 {
   ssize_t symtab = OpElf_findSection(elf, ".symtab");
   if ( symtab == -1 )
@@ -24,51 +79,50 @@ static void nmElf(OpElf* elf, size_t ptrstrwidth)
   else {
     Elf64_SectionHeader sec = elf->sectionHeaders[symtab];
 
+    // sh_info is one past the last local symbol; locals can never be
+    // undefined, so both -g and -u never need to decode them
+    size_t first = 1; // first symbol is fake
+    if ( (opts->extern_only || opts->undefined_only) && sec.sh_info > first )
+      first = sec.sh_info;
+
     char * tsstab;
     if ( Elf_getStrTable(&tsstab, NULL, sec.sh_link, &elf->header, elf->file, errclbk) ) {
       fprintf(stderr, "failed to decode string table used by section\n");
     }
     else {
-      Elf64_Sym* syms;
+      Elf64_Sym* syms = NULL;
       size_t syms_len = 0;
-      if ( Elf_getSymTable(&syms, &syms_len, &elf->header, &sec, elf->file, errclbk) )
+      if ( Elf_getSymTableFrom(&syms, &syms_len, first, &elf->header, &sec, elf->file, errclbk) )
       {
         fprintf(stderr, "failed to decode symbol table\n");
-      }
-
-      if ( syms_len ) {
-        // first symbol is fake
-        syms_len --;
-        syms ++;
+        syms_len = 0;
       }
 
       for (size_t u = 0; u < syms_len; u++)
       {
-        uint8_t bind_attrib = syms[u].info >> 4;
-        uint8_t sym_type = syms[u].info & 0xF;
+        Elf64_Sym const* sym = &syms[u];
+
+        bool is_undef = sym->shndx == SHN_UNDEF;
+        if ( opts->undefined_only && !is_undef )
+          continue;
+        if ( opts->defined_only && is_undef )
+          continue;
+
+        bool is_global = first + u >= sec.sh_info;
 
         const char * sname = NULL;
         {
           uint32_t sectionnam = 0;
-          if ( syms[u].shndx && syms[u].shndx < elf->header.part3.shnum )
-            sectionnam = elf->sectionHeaders[syms[u].shndx].sh_name;
+          if ( sym->shndx && sym->shndx < elf->header.part3.shnum )
+            sectionnam = elf->sectionHeaders[sym->shndx].sh_name;
           if ( sectionnam ) 
             sname = elf->master_strtab + sectionnam;
         }
 
-        bool is_global = u >= sec.sh_info;
-
-        if ( syms[u].value ) {
-          printf("%016" PRIXPTR, (uintptr_t) syms[u].value);
-        } else {
-          for ( size_t i = 0; i < ptrstrwidth; i ++ )
-            fputc(' ', stdout);
-        }
-
         char id = '?';
-        if ( syms[u].shndx == SHN_UNDEF )
+        if ( is_undef )
           id = 'U';
-        else if ( syms[u].shndx == SHN_ABS )
+        else if ( sym->shndx == SHN_ABS )
           id = 'A';
         else if ( sname && !strcmp(sname, ".text") )
           id = is_global ? 'T' : 't';
@@ -79,54 +133,95 @@ static void nmElf(OpElf* elf, size_t ptrstrwidth)
         else if ( sname && !strcmp(sname, ".rodata") )
           id = is_global ? 'R' : 'r';
 
-        printf(" %c ", id);
+        uint32_t name = sym->name;
+        char const* nam = "unnamed";
+        if ( name && *(tsstab + name) )
+          nam = symName(tsstab + name, opts);
 
-        uint32_t name = syms[u].name;
-        if ( name && *(tsstab + name) ) {
-          printf("%s\n", tsstab + name);
-        } else {
-          printf("unnamed\n");
-        }
+        printSym(nam, id, sym->value, sym->value, opts);
       }
 
+      free(syms);
       free(tsstab);
     }
   }
 }
 
-static void nmAof(AofObj* o, size_t ptrstrwidth)
+/** ref_area is the string table offset of the area name, not an index */
+static AofAreaHeader const* aofRefArea(AofObj* o, uint32_t ref_area)
+{
+    for (size_t i = 0; i < o->aof.header.num_areas; i ++)
+        if ( o->aof.areas[i].name == ref_area )
+            return &o->aof.areas[i];
+
+    // the same name could also be stored twice in the string table
+    char const* name = ChunkFile_getStr(&o->ch, ref_area);
+    if ( !name )
+        return NULL;
+    for (size_t i = 0; i < o->aof.header.num_areas; i ++)
+    {
+        char const* an = ChunkFile_getStr(&o->ch, o->aof.areas[i].name);
+        if ( an && !strcmp(an, name) )
+            return &o->aof.areas[i];
+    }
+    return NULL;
+}
+
+static void nmAof(AofObj* o, NmOpts const* opts)
 {
     for (size_t sy = 0; sy < o->aof.header.num_syms; sy ++)
     {
         AofSym* sym = &o->aof.syms[sy];
-        if ( sym->attribs & AofSymAttr_ABS && sym->value ) {
-          printf("%016" PRIXPTR, (uintptr_t) sym->value);
-        } else {
-          for ( size_t i = 0; i < ptrstrwidth; i ++ )
-            fputc(' ', stdout);
-        }
+
+        // filter on the attributes before touching areas or the string table
+        bool is_defined = sym->attribs & AofSymAttr_DEFINE;
+        bool is_global = sym->attribs & AofSymAttr_GLOBAL;
+        if ( opts->extern_only && !is_global )
+            continue;
+        if ( opts->undefined_only && is_defined )
+            continue;
+        if ( opts->defined_only && !is_defined )
+            continue;
 
         char id = '?';
-        if ( sym->attribs & AofSymAttr_ABS )
+        if ( !is_defined )
+            id = 'U';
+        else if ( sym->attribs & AofSymAttr_ABS )
             id = 'A';
-        else 
+        else
         {
-            AofAreaAttrib area = o->aof.areas[sym->ref_area].attributes;
-            if ( (area &  AofAreaAttrib_CODE) && (sym->attribs & AofSymAttr_DEFINE) )
-                id = ( sym->attribs & AofSymAttr_GLOBAL ) ? 'T' : 't';
-            else if ( (area &  AofAreaAttrib_R_ONLY) && (sym->attribs & AofSymAttr_DEFINE) )
-                id = ( sym->attribs & AofSymAttr_GLOBAL ) ? 'R' : 'r';
-            else if ( sym->attribs & AofSymAttr_DEFINE )
-                id = ( sym->attribs & AofSymAttr_GLOBAL ) ? 'D' : 'd';
+            AofAreaHeader const* area = aofRefArea(o, sym->ref_area);
+            if ( !area )
+                id = '?';
+            else if ( area->attributes & AofAreaAttrib_CODE )
+                id = is_global ? 'T' : 't';
+            else if ( area->attributes & AofAreaAttrib_R_ONLY )
+                id = is_global ? 'R' : 'r';
+            else
+                id = is_global ? 'D' : 'd';
         }
 
         char const* name = ChunkFile_getStr(&o->ch, sym->name);
+        name = name ? symName(name, opts) : "";
 
-        printf(" %c %s\n", id, name);
+        printSym(name, id, sym->value, (sym->attribs & AofSymAttr_ABS) && sym->value, opts);
     }
 }
 
-static void nmPe(OpPe* pe, size_t ptrstrwidth)
+/** --lookup in a single object: one probe of its symbol table */
+static int nmAofLookup(AofObj* o, char const* path, NmOpts const* opts)
+{
+    AofSym const* sym = AofObj_lookupSymbol(o, opts->lookup);
+    if ( !sym || !(sym->attribs & AofSymAttr_DEFINE) )
+    {
+        fprintf(stderr, "%s: not found\n", opts->lookup);
+        return 1;
+    }
+    printf("%s in %s\n", symName(opts->lookup, opts), path);
+    return 0;
+}
+
+static void nmPe(OpPe* pe, NmOpts const* opts)
 {
   OpPe_rewindToSyms(pe);
   for ( size_t i = 0; i < pe->header.numCoffSym; i ++ )
@@ -134,76 +229,110 @@ static void nmPe(OpPe* pe, size_t ptrstrwidth)
     CoffSym sym;
     OpPe_nextSym(&sym, pe);
 
-    if ( !(sym.sectionId == 0xFFFE) ) // not debug 
+    bool discard = false;
+    if ( sym.sectionId == 0xFFFE ) // debug
+      discard = true;
+    else if ( sym.storageClass == IMAGE_SYM_CLASS_SECTION )
+      discard = true;
+    else if ( sym.storageClass == IMAGE_SYM_CLASS_CLR_TOKEN )
+      discard = true;
+    else if ( sym.storageClass == IMAGE_SYM_CLASS_FILE )
+      discard = true;
+    else if ( sym.storageClass == IMAGE_SYM_CLASS_STATIC && sym.name[0] == '.' )
+      discard = true;
+
+    // filter on storage class and section before resolving any names
+    bool is_global = sym.storageClass == IMAGE_SYM_CLASS_EXTERNAL;
+    bool is_undef = sym.sectionId == 0;
+    if ( opts->extern_only && !is_global )
+      discard = true;
+    else if ( opts->undefined_only && !is_undef )
+      discard = true;
+    else if ( opts->defined_only && is_undef )
+      discard = true;
+
+    if ( !discard )
     {
+      char shortname[9];
       const char * name = CoffSym_name(&sym, pe);
-
-      bool discard = false;
+      if ( name == sym.name ) {
+        // short names are not null terminated if they use all 8 bytes
+        memcpy(shortname, sym.name, 8);
+        shortname[8] = '\0';
+        name = shortname;
+      }
+      name = symName(name, opts);
 
       const char * sname = NULL;
-      if ( sym.sectionId && sym.sectionId != 0xFFFF && sym.sectionId < pe->header.numSections )
+      char sbname[9];
+      // section numbers start at 1
+      if ( sym.sectionId && sym.sectionId <= pe->header.numSections )
       {
         PeSection section;
-        OpPe_getPeSection(&section, pe, sym.sectionId);
+        OpPe_getPeSection(&section, pe, sym.sectionId - 1);
 
-        char sbname[9];
         sbname[8] = '\0';
         memcpy(sbname, section.name, 8);
         sname = sbname;
       }
 
-      if ( sym.storageClass == IMAGE_SYM_CLASS_SECTION )
-        discard = true;
-      else if ( sym.storageClass == IMAGE_SYM_CLASS_CLR_TOKEN )
-        discard = true;
-      else if ( sym.storageClass == IMAGE_SYM_CLASS_FILE )
-        discard = true;
-      else if ( sym.storageClass == IMAGE_SYM_CLASS_STATIC && sym.name[0] == '.' )
-        discard = true;
-
-      if ( !discard )
-      {
-        if ( sym.value ) {
-          printf("%016" PRIXPTR, (uintptr_t) sym.value);
-        } else {
-          for ( size_t i = 0; i < ptrstrwidth; i ++ )
-            fputc(' ', stdout);
-        }
-
-        bool is_global = sym.storageClass == IMAGE_SYM_CLASS_EXTERNAL;
-
-        char type = '?';
-        if ( sym.sectionId == 0xFFFF )
-          type = 'A';
-        else if ( sym.sectionId == 0 )
-          type = 'U';
-        else if ( sname && !strcmp(sname, ".text") )
-          type = is_global ? 'T' : 't';
-        else if ( sname && !strcmp(sname, ".bss") )
-          type = is_global ? 'B' : 'b';
-        else if ( sname && !strcmp(sname, ".data") )
-          type = is_global ? 'D' : 'd';
-        else if ( sname && !strcmp(sname, ".rdata") )
-          type = is_global ? 'R' : 'r';
-
-        printf(" %c %s\n", type, name);
-      }
+      char type = '?';
+      if ( sym.sectionId == 0xFFFF )
+        type = 'A';
+      else if ( is_undef )
+        type = 'U';
+      else if ( sname && !strcmp(sname, ".text") )
+        type = is_global ? 'T' : 't';
+      else if ( sname && !strcmp(sname, ".bss") )
+        type = is_global ? 'B' : 'b';
+      else if ( sname && !strcmp(sname, ".data") )
+        type = is_global ? 'D' : 'd';
+      else if ( sname && !strcmp(sname, ".rdata") )
+        type = is_global ? 'R' : 'r';
+
+      printSym(name, type, sym.value, sym.value, opts);
     }
 
     // skip following aux sysm
-    for ( size_t j = 0; j < sym.numAuxSyms; j ++ )
+    uint8_t numAux = sym.numAuxSyms;
+    for ( size_t j = 0; j < numAux; j ++ )
       OpPe_nextSym(&sym, pe);
-    i += sym.numAuxSyms;
+    i += numAux;
+  }
+}
+
+/**
+ * short import members define the import table slot __imp_<name>, code
+ * imports also the thunk <name>; the ordinal is shown as the value
+ */
+static void nmCoffImport(CoffImport const* imp, NmOpts const* opts)
+{
+  // imports are always defined and global
+  if ( opts->undefined_only )
+    return;
+
+  bool byOrdinal = imp->nameType == IMPORT_OBJECT_ORDINAL;
+  size_t len = strlen(imp->symbol);
+  char* slot = malloc(len + 7);
+  if ( slot )
+  {
+    memcpy(slot, "__imp_", 6);
+    memcpy(slot + 6, imp->symbol, len + 1);
+    printSym(symName(slot, opts), 'I', imp->ordinalOrHint, byOrdinal, opts);
+    free(slot);
   }
+
+  if ( imp->type == IMPORT_OBJECT_CODE )
+    printSym(symName(imp->symbol, opts), 'T', imp->ordinalOrHint, byOrdinal, opts);
 }
 
-static int nmObjfile(FILE* file, size_t ptrstrwidth)
+static int nmObjfile(FILE* file, NmOpts const* opts)
 {
   OpElf elf;
   rewind(file);
   if ( !OpElf_open(&elf, file, NULL) )
   {
-    nmElf(&elf, ptrstrwidth);
+    nmElf(&elf, opts);
     OpElf_close(&elf);
     return 0;
   }
@@ -212,7 +341,7 @@ static int nmObjfile(FILE* file, size_t ptrstrwidth)
   rewind(file);
   if ( !OpPe_open(&pe, file) )
   {
-    nmPe(&pe, ptrstrwidth);
+    nmPe(&pe, opts);
     OpPe_close(&pe);
     return 0;
   }
@@ -221,7 +350,7 @@ static int nmObjfile(FILE* file, size_t ptrstrwidth)
   rewind(file);
   if ( !AofObj_open(&aof, file) )
   {
-    nmAof(&aof, ptrstrwidth);
+    nmAof(&aof, opts);
     AofObj_close(&aof);
     return 0;
   }
@@ -229,76 +358,454 @@ static int nmObjfile(FILE* file, size_t ptrstrwidth)
   return 1;
 }
 
-static void nmAr(SmartArchive* ar, size_t ptrstrwidth)
+/** prints which member defines each symbol, using only the symbol index */
+static int nmArmap(SmartArchive* ar, NmOpts const* opts)
 {
+  ArSymIndex idx;
+  if ( SmartArchive_readSymIndex(&idx, ar) )
+  {
+    fprintf(stderr, "malformed archive symbol index\n");
+    return 1;
+  }
+
+  if ( !idx.syms_len )
+  {
+    fprintf(stderr, "archive has no symbol index\n");
+    ArSymIndex_free(&idx);
+    return 0;
+  }
+
+  printf("Archive index:\n");
+
+  // entries of one member are next to each other, so only the member
+  // header that changed has to be read
+  char* member = NULL;
+  uint64_t memberOffset = 0;
+  for ( size_t i = 0; i < idx.syms_len; i ++ )
+  {
+    ArSym const* sym = &idx.syms[i];
+    if ( !member || sym->offset != memberOffset )
+    {
+      free(member);
+      SmartArchive_seekMember(ar, sym->offset);
+      member = SmartArchive_nextFileNameHeap(ar);
+      memberOffset = sym->offset;
+    }
+
+    printf("%s in %s\n", symName(sym->name, opts), member ? member : "?");
+  }
+  fputc('\n', stdout);
+
+  free(member);
+  ArSymIndex_free(&idx);
   SmartArchive_rewind(ar);
+  return 0;
+}
+
+/**
+ * for archives that can not be mapped, e.g. bigger than the address space:
+ * a member is only read into memory once its first bytes look like an object file
+ */
+static void nmArStream(FILE* f, char const* path, NmOpts const* opts)
+{
+  SmartArchive ar;
+  if ( SmartArchive_open(&ar, f) )
+  {
+    fprintf(stderr, "could not read archive\n");
+    return;
+  }
+  SmartArchive_setPath(&ar, path);
 
   char* name;
-  while ( (name = SmartArchive_nextFileNameHeap(ar)) )
+  while ( (name = SmartArchive_nextFileNameHeap(&ar)) )
   {
-    printf("%s:\n", name);
+    if ( Ar_isMetaMember(name) )
+    {
+      SmartArchive_continueNoData(&ar);
+      free(name);
+      continue;
+    }
+
+    if ( opts->writer )
+      RecWriter_file(opts->writer, path, name);
+    else
+      printf("%s:\n", name);
+
+    unsigned char magic[4];
+    size_t got = SmartArchive_peekData(&ar, magic, sizeof(magic));
+
+    void* data = NULL;
+    size_t size = 0;
+    FILE* file = NULL;
+    CoffImport imp;
+    ObjFmt fmt = ObjFmt_detect(magic, got);
+    bool isImport = false;
+    if ( fmt == ObjFmt_UNKNOWN )
+      SmartArchive_continueNoData(&ar);
+    else if ( !SmartArchive_continueWithData(&data, &size, &ar) && size )
+    {
+      // import members are parsed from the data, they are not opened as a file
+      isImport = fmt == ObjFmt_COFF_IMPORT && !CoffImport_parse(&imp, data, size);
+      if ( !isImport )
+        file = memFileOpenReadOnly(data, size);
+    }
+
+    if ( isImport )
+      nmCoffImport(&imp, opts);
+    else if ( !file || nmObjfile(file, opts) )
+    {
+      if ( opts->writer )
+        fprintf(stderr, "%s: unrecognized format\n", name);
+      else
+        printf("unrecognized format\n");
+    }
+
+    if ( file )
+      fclose(file);
+    free(data);
     free(name);
 
-    void* data; size_t size;
-    if ( SmartArchive_continueWithData(&data, &size, ar) )
+    if ( !opts->writer )
+      fputc('\n', stdout);
+  }
+
+  SmartArchive_close(&ar);
+}
+
+static void nmAr(FILE* f, char const* path, NmOpts const* opts)
+{
+  MappedArchive ar;
+  if ( MappedArchive_open(&ar, f) )
+  {
+    nmArStream(f, path, opts);
+    return;
+  }
+  MappedArchive_setPath(&ar, path);
+
+  char* name = NULL;
+  size_t nameCap = 0;
+  ArMemberView m;
+  while ( MappedArchive_next(&ar, &m) )
+  {
+    if ( ArMemberView_nameStr(&m, &name, &nameCap) )
     {
       fprintf(stderr, "out of memory\n");
-      return;
+      break;
     }
 
-    FILE* file = memFileOpenReadOnly(data, size);
+    if ( opts->writer )
+      RecWriter_file(opts->writer, path, name);
+    else
+      printf("%s:\n", name);
 
-    if ( nmObjfile(file, ptrstrwidth) )
+    if ( !m.data )
     {
-      printf("unrecognized format\n");
+      fprintf(stderr, "%s: could not open member\n", name);
+      continue;
     }
 
-    fclose(file);
-    free(data);
+    // import libraries have thousands of these, so they are not opened as a file
+    CoffImport imp;
+    if ( !CoffImport_parse(&imp, m.data, m.size) )
+    {
+      nmCoffImport(&imp, opts);
+      if ( !opts->writer )
+        fputc('\n', stdout);
+      continue;
+    }
+
+    // the member is read straight out of the mapping
+    FILE* file = m.size ? memFileOpenReadOnly((void*) m.data, m.size) : NULL;
+
+    if ( !file || nmObjfile(file, opts) )
+    {
+      if ( opts->writer )
+        fprintf(stderr, "%s: unrecognized format\n", name);
+      else
+        printf("unrecognized format\n");
+    }
+
+    if ( file )
+      fclose(file);
+
+    if ( !opts->writer )
+      fputc('\n', stdout);
+  }
+
+  free(name);
+  MappedArchive_close(&ar);
+}
+
+/**
+ * --lookup: a binary search in a sorted index, otherwise one probe of the
+ * hashed symbol index; no member is opened
+ */
+static int nmArLookup(MappedArchive* ar, FILE* f, NmOpts const* opts)
+{
+  uint64_t offset;
+  int err;
+  if ( MappedArchive_hasSortedIndex(ar) )
+    err = MappedArchive_lookupSortedSymbol(ar, opts->lookup, &offset);
+  else
+  {
+    SmartArchive sar;
+    err = SmartArchive_open(&sar, f);
+    if ( !err )
+    {
+      err = SmartArchive_lookupSymbol(&sar, opts->lookup, &offset);
+      SmartArchive_close(&sar);
+    }
+  }
+  if ( err )
+  {
+    fprintf(stderr, "%s: not found\n", opts->lookup);
+    return 1;
+  }
 
-    fputc('\n', stdout);
+  ArMemberView m;
+  MappedArchive_seekMember(ar, offset);
+  if ( !MappedArchive_next(ar, &m) || m.offset != offset )
+  {
+    fprintf(stderr, "%s: index points to no member\n", opts->lookup);
+    return 1;
   }
+  printf("%s in %.*s\n", symName(opts->lookup, opts), (int) m.nameLen, m.name);
+  return 0;
+}
+
+typedef struct {
+  Alf* alf;
+  NmOpts const* opts;
+} NmAlfSymCtx;
+
+static int nmAlfSym(void* ctx, char const* name, uint32_t chunk_index)
+{
+  NmAlfSymCtx* c = ctx;
+  AlfMember m;
+  if ( !Alf_member(c->alf, chunk_index, &m) )
+    printf("%s in %.*s\n", symName(name, c->opts), (int) m.name_len, m.name);
+  else
+    printf("%s in ?\n", symName(name, c->opts));
+  return 0;
 }
 
-static char supportedFormatsStr[] = "Support file formats: {,AR of }{ELF{32,64},PE,COFF}";
+/** --lookup: one probe of the symbol table, no member is opened */
+static int nmAlfLookup(Alf* alf, NmOpts const* opts)
+{
+  if ( !Alf_hasSymtab(alf) )
+  {
+    fprintf(stderr, "library has no up to date symbol table\n");
+    return 1;
+  }
+
+  AlfMember m;
+  if ( Alf_lookupSymbol(alf, opts->lookup, &m) )
+  {
+    fprintf(stderr, "%s: not found\n", opts->lookup);
+    return 1;
+  }
+  printf("%s in %.*s\n", symName(opts->lookup, opts), (int) m.name_len, m.name);
+  return 0;
+}
+
+/** ALF libraries; the symbol table takes the place of the archive index */
+static int nmAlf(Alf* alf, char const* path, NmOpts const* opts)
+{
+  int code = 0;
+  if ( opts->print_armap )
+  {
+    if ( !Alf_hasSymtab(alf) )
+      fprintf(stderr, "library has no up to date symbol table\n");
+    else
+    {
+      printf("Archive index:\n");
+      NmAlfSymCtx ctx = { alf, opts };
+      if ( Alf_forEachSym(alf, nmAlfSym, &ctx) )
+      {
+        fprintf(stderr, "malformed library symbol table\n");
+        code = 1;
+      }
+      fputc('\n', stdout);
+    }
+  }
+
+  AlfMember m;
+  char* name = NULL;
+  while ( !opts->index_only && Alf_next(alf, &m) )
+  {
+    free(name);
+    name = strndup(m.name, m.name_len);
+    if ( !name )
+      break;
+
+    if ( opts->writer )
+      RecWriter_file(opts->writer, path, name);
+    else
+      printf("%s:\n", name);
+
+    // the member is read from the library file where it is
+    AofObj aof;
+    if ( !Alf_openMember(&aof, alf, &m) )
+    {
+      nmAof(&aof, opts);
+      AofObj_close(&aof);
+    }
+    else if ( opts->writer )
+      fprintf(stderr, "%s: unrecognized format\n", name);
+    else
+      printf("unrecognized format\n");
+
+    if ( !opts->writer )
+      fputc('\n', stdout);
+  }
+
+  free(name);
+  return code;
+}
+
+static char supportedFormatsStr[] = "Support file formats: {,AR of }{ELF{32,64},PE,COFF,AOF}, ALF, COFF import libraries";
+
+static void printUsage(char const* prog)
+{
+  fprintf(stderr, "Usage: %s [options] [file]\n"
+      " options:\n"
+      "  -g, --extern-only     only display external symbols\n"
+      "  -u, --undefined-only  only display undefined symbols\n"
+      "      --defined-only    only display defined symbols\n"
+      "  -C, --demangle        decode C++ symbol names\n"
+      "  -s, --print-armap     print the archive symbol index\n"
+      "      --index-only      only print the archive symbol index\n"
+      "      --lookup=NAME     print the member of an archive or ALF library that\n"
+      "                        defines NAME, according to its index;\n"
+      "                        for an AOF object, whether it defines NAME\n"
+      "      --format=FORMAT   bsd (default), json or binary (docs/record-format.md)\n"
+      "%s\n", prog, supportedFormatsStr);
+}
 
 int main(int argc, char const* const* argv)
 {
-  size_t ptrstrwidth;
+  NmOpts opts = {0};
+  RecWriter writer;
+  RecFormat format;
+  bool machine = false;
+  Demangler demangler;
+  Demangler_init(&demangler);
   {
     char buf[32];
     sprintf(buf, "%016" PRIXPTR, (uintptr_t) argv);
-    ptrstrwidth = strlen(buf);
+    opts.ptrstrwidth = strlen(buf);
   }
 
-  if ( argc != 2 ) {
-    fprintf(stderr, "Usage: %s [file]\n%s\n", argv[0], supportedFormatsStr);
+  char const* path = NULL;
+  for ( int i = 1; i < argc; i ++ )
+  {
+    char const* arg = argv[i];
+    if ( !strcmp(arg, "-g") || !strcmp(arg, "--extern-only") )
+      opts.extern_only = true;
+    else if ( !strcmp(arg, "-u") || !strcmp(arg, "--undefined-only") )
+      opts.undefined_only = true;
+    else if ( !strcmp(arg, "--defined-only") )
+      opts.defined_only = true;
+    else if ( !strcmp(arg, "-C") || !strcmp(arg, "--demangle") )
+      opts.demangler = &demangler;
+    else if ( !strcmp(arg, "-s") || !strcmp(arg, "--print-armap") )
+      opts.print_armap = true;
+    else if ( !strcmp(arg, "--index-only") )
+      opts.index_only = opts.print_armap = true;
+    else if ( !strncmp(arg, "--lookup=", 9) && arg[9] )
+      opts.lookup = arg + 9;
+    else if ( !strcmp(arg, "--format=bsd") )
+      machine = false;
+    else if ( !strncmp(arg, "--format=", 9) && !RecFormat_parse(&format, arg + 9) )
+      machine = true;
+    else if ( arg[0] == '-' || path ) {
+      printUsage(argv[0]);
+      return 1;
+    }
+    else
+      path = arg;
+  }
+
+  // the archive index has no record representation
+  if ( !path || (opts.undefined_only && opts.defined_only) || (machine && opts.print_armap) ||
+       (opts.lookup && (machine || opts.print_armap)) ) {
+    printUsage(argv[0]);
     return 1;
   }
 
-  FILE* f = fopen(argv[1], "rb");
+  FILE* f = fopen(path, "rb");
   if ( f == NULL ) {
     fprintf(stderr, "could not open file\n");
     return 1;
   }
 
+  if ( machine ) {
+    RecWriter_begin(&writer, stdout, format, "nm");
+    opts.writer = &writer;
+  }
+
+  int code = 0;
   SmartArchive ar;
+  Alf alf;
   rewind(f);
-  if ( !SmartArchive_open(&ar, f ) )
+  AofObj aof;
+  MappedArchive mar;
+  if ( opts.lookup )
+  {
+    if ( !MappedArchive_open(&mar, f) )
+    {
+      code = nmArLookup(&mar, f, &opts);
+      MappedArchive_close(&mar);
+    }
+    else if ( !Alf_open(&alf, f) )
+    {
+      code = nmAlfLookup(&alf, &opts);
+      Alf_close(&alf);
+    }
+    else if ( !AofObj_open(&aof, f) )
+    {
+      code = nmAofLookup(&aof, path, &opts);
+      AofObj_close(&aof);
+    }
+    else
+    {
+      fprintf(stderr, "not an archive, ALF library or AOF object\n");
+      code = 1;
+    }
+  }
+  else if ( !SmartArchive_open(&ar, f ) )
   {
-    nmAr(&ar, ptrstrwidth);
+    if ( opts.print_armap )
+      code = nmArmap(&ar, &opts);
     SmartArchive_close(&ar);
-    fclose(f);
-    return 0;
+    if ( !opts.index_only )
+      nmAr(f, path, &opts);
   }
-
-  if ( !nmObjfile(f, ptrstrwidth) )
+  else if ( !Alf_open(&alf, f) )
   {
-    fclose(f);
-    return 0;
+    code = nmAlf(&alf, path, &opts);
+    Alf_close(&alf);
+  }
+  else if ( opts.index_only )
+  {
+    fprintf(stderr, "not an archive\n");
+    code = 1;
+  }
+  else
+  {
+    if ( opts.writer )
+      RecWriter_file(opts.writer, path, NULL);
+    if ( nmObjfile(f, &opts) )
+    {
+      fprintf(stderr, "Unsupported file format! %s\n", supportedFormatsStr);
+      code = 1;
+    }
   }
 
-  fprintf(stderr, "Unsupported file format! %s\n", supportedFormatsStr);
+  if ( opts.writer )
+    RecWriter_end(opts.writer);
+
+  Demangler_free(&demangler);
   fclose(f);
-  return 1;
+  return code;
 }
@@ -72,20 +72,18 @@ static int op_areaextract(Aof aof, ChunkFile ch, char const * arg)
         if ( strcmp(name, arg) )
             continue;
 
-        size_t off = Aof_areaFileOffset(&ch, &aof, i);
-        fseek(ch.file, off, SEEK_SET);
-
-        for (size_t j = 0; j < h->size; j ++)
-        {
-            int c = fgetc(ch.file);
-            if ( c == EOF )
-                continue;
-
-            fputc(c, stdout);
-        }
+        // one write straight from the mapping; zero initialized areas are not in the file
+        uint8_t const* data = Aof_areaData(&ch, &aof, i);
+        void* zeros = NULL;
+        if ( !data && (h->attributes & AofAreaAttrib_ZEROI) )
+            data = zeros = calloc(1, h->size ? h->size : 1);
+        if ( !data )
+            return 1;
 
+        int err = fwrite(data, 1, h->size, stdout) != h->size;
+        free(zeros);
         fflush(stdout);
-        return 0;
+        return err;
     }
 
     return 1;
@@ -101,7 +99,7 @@ int main(int argc, char ** argv)
     char const* oparg = argc > 3 ? argv[3] : NULL;
 
     ChunkFile ch = {0};
-    if ( ChunkFile_open(&ch, f) != 0 ) {
+    if ( ChunkFile_openMapped(&ch, f) != 0 ) {
         printf("doesn't seem like a AOF file\n");
         return 1;
     }
@@ -1,7 +1,11 @@
 #include "ubu/pe.h"
 #include "ubu/elf.h"
 #include "ubu/ar.h"
+#include "ubu/alf.h"
 #include "ubu/memfile.h"
+#include "ubu/recwriter.h"
+#include "ubu/utils.h"
+#include "ubu/parallel.h"
 #include <string.h>
 
 /*
@@ -12,153 +16,571 @@ text <t> data <t> bss <t> total <t> filename
 
 */
 
-static size_t elfSectionSize(OpElf* elf, const char * name)
+/** text, data, bss */
+typedef size_t Sizes[3];
+
+/** one line of the SysV (-A) output */
+typedef struct {
+  char* name /** heap */;
+  uint64_t size;
+  uint64_t addr;
+} SizeSec;
+
+typedef struct {
+  SizeSec* secs;
+  size_t len, cap;
+} SizeSecs;
+
+static void sizeSecsFree(SizeSecs* s)
 {
-  ssize_t s = OpElf_findSection(elf, name);
-  size_t size = 0;
-  if ( s != -1 ) {
-    size = elf->sectionHeaders[s].sh_size;
-  }
-  return size;
+  for ( size_t i = 0; i < s->len; i ++ )
+    free(s->secs[i].name);
+  free(s->secs);
+  memset(s, 0, sizeof(SizeSecs));
 }
 
-static void sizeElf(OpElf* elf, const char * filename)
+/** [secs] NULL = only the Berkeley sums are wanted; 0 = ok */
+static int sizeSecsPush(SizeSecs* secs, char const* name, size_t nameLen, uint64_t size, uint64_t addr)
 {
-  size_t s_text = elfSectionSize(elf, ".text");
+  if ( !secs )
+    return 0;
+  if ( secs->len == secs->cap )
+  {
+    size_t cap = secs->cap ? secs->cap * 2 : 16;
+    SizeSec* n = realloc(secs->secs, cap * sizeof(SizeSec));
+    if ( !n )
+      return 1;
+    secs->secs = n;
+    secs->cap = cap;
+  }
+  char* copy = strndup(name, nameLen);
+  if ( !copy )
+    return 1;
+  secs->secs[secs->len ++] = (SizeSec) { copy, size, addr };
+  return 0;
+}
 
-  size_t s_data = elfSectionSize(elf, ".data");
-  s_data += elfSectionSize(elf, ".rodata");
+/**
+ * the Berkeley classification of GNU size: only allocated sections count;
+ * code and read only sections are text, the rest data, unless they have no contents
+ */
+static void sizeClassify(Sizes sizes, uint64_t size, bool code, bool readOnly, bool noBits)
+{
+  if ( code || readOnly )
+    sizes[0] += size;
+  else if ( !noBits )
+    sizes[1] += size;
+  else
+    sizes[2] += size;
+}
 
-  size_t s_bss = elfSectionSize(elf, ".bss");
+static void printSizes(Sizes const sizes, RecWriter* w, const char * path, const char * member)
+{
+  if ( w ) {
+    RecWriter_file(w, path, member);
+    RecWriter_size(w, sizes[0], sizes[1], sizes[2]);
+    return;
+  }
 
-  size_t total = s_text + s_data + s_bss;
+  printf("%zu\t%zu\t%zu\t%zu\t",
+      sizes[0], sizes[1], sizes[2], sizes[0] + sizes[1] + sizes[2]);
+  // with many inputs, members are told apart by their archive like GNU size does
+  if ( member )
+    printf("%s (ex %s)\n", member, path);
+  else
+    printf("%s\n", path);
+}
 
-  printf("%zu\t%zu\t%zu\t%zu\t%s\n",
-      s_text, s_data, s_bss, total, filename);
+/** like GNU size -A: the columns are as wide as their longest entry; "section" may stick out */
+static void printSysv(SizeSecs const* secs, const char * path, const char * member)
+{
+  int nameW = 0, sizeW = 4, addrW = 4;
+  uint64_t total = 0;
+  char buf[24];
+  for ( size_t i = 0; i < secs->len; i ++ )
+  {
+    SizeSec const* sec = &secs->secs[i];
+    int n = (int) strlen(sec->name);
+    if ( n > nameW ) nameW = n;
+    n = sprintf(buf, "%llu", (unsigned long long) sec->size);
+    if ( n > sizeW ) sizeW = n;
+    n = sprintf(buf, "%llu", (unsigned long long) sec->addr);
+    if ( n > addrW ) addrW = n;
+    total += sec->size;
+  }
+  int n = sprintf(buf, "%llu", (unsigned long long) total);
+  if ( n > sizeW ) sizeW = n;
+
+  if ( member )
+    printf("%s   (ex %s):\n", member, path);
+  else
+    printf("%s  :\n", path);
+  printf("%-*s   %*s   %*s\n", nameW, "section", sizeW, "size", addrW, "addr");
+  for ( size_t i = 0; i < secs->len; i ++ )
+  {
+    SizeSec const* sec = &secs->secs[i];
+    printf("%-*s   %*llu   %*llu\n", nameW, sec->name, sizeW, (unsigned long long) sec->size,
+           addrW, (unsigned long long) sec->addr);
+  }
+  printf("%-*s   %*llu\n\n\n", nameW, "Total", sizeW, (unsigned long long) total);
 }
 
-static void sizePe(OpPe* pe, const char * filename)
+/** one pass over the section headers, section data is never read */
+static int sizeElf(OpElf* elf, Sizes sizes, SizeSecs* secs)
 {
-  size_t secSizes[3] = {0,0,0};
-  int numPopulatedSec = 0;
-  size_t sum = 0;
+  sizes[0] = sizes[1] = sizes[2] = 0;
+  for ( size_t i = 0; i < elf->header.part3.shnum; i ++ )
+  {
+    Elf64_SectionHeader const* sh = &elf->sectionHeaders[i];
+    bool alloc = sh->sh_flags & SHF_ALLOC;
+
+    // GNU size does not show what only describes the symbols and relocations
+    bool shown = sh->sh_type != SHT_NULL && sh->sh_type != SHT_SYMTAB &&
+                 sh->sh_type != 17 /* SHT_GROUP */ && sh->sh_type != 18 /* SHT_SYMTAB_SHNDX */ &&
+                 (alloc || (sh->sh_type != SHT_STRTAB && sh->sh_type != SHT_REL && sh->sh_type != SHT_RELA));
+    char const* name = sh->sh_name ? elf->master_strtab + sh->sh_name : "";
+    if ( shown && sizeSecsPush(secs, name, strlen(name), sh->sh_size, sh->sh_addr) )
+      return 1;
+
+    if ( alloc )
+      sizeClassify(sizes, sh->sh_size, sh->sh_flags & SHF_EXECINSTR,
+                   !(sh->sh_flags & SHF_WRITE), sh->sh_type == SHT_NOBITS);
+  }
+  return 0;
+}
 
+static int sizePe(OpPe* pe, Sizes sizes, SizeSecs* secs)
+{
+  sizes[0] = sizes[1] = sizes[2] = 0;
   for ( uint16_t i = 0; i < pe->header.numSections; i ++ )
   {
     PeSection sec;
     OpPe_getPeSection(&sec, pe, i);
+    CoffSectionCharacteristics c = sec.characteristics;
 
-    int sidx;
-    if ( !strcmp(sec.name, ".text") )
-      sidx = 0;
-    else if ( !strcmp(sec.name, ".bss") )
-      sidx = 2;
-    else if ( !strcmp(sec.name, ".data") )
-      sidx = 1;
-    else if ( !strcmp(sec.name, ".rdata") )
-      sidx = 1;
-    else 
+    if ( sizeSecsPush(secs, sec.name, strnlen(sec.name, 8), sec.dataUz, sec.virtualAddress) )
+      return 1;
+
+    // linker directives and debug info are not part of the image
+    if ( (c & (IMAGE_SCN_LNK_INFO | IMAGE_SCN_LNK_REMOVE)) || !strncmp(sec.name, ".debug", 6) )
       continue;
+    sizeClassify(sizes, sec.dataUz, c & (IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE),
+                 !(c & IMAGE_SCN_MEM_WRITE), c & IMAGE_SCN_CNT_UNINITIALIZED_DATA);
+  }
+  return 0;
+}
 
-    secSizes[sidx] = sec.dataUz;
-    sum += sec.dataUz;
+/** areas work like sections; [ch] is only needed for the names of -A */
+static int sizeAof(Aof const* aof, ChunkFile* ch, Sizes sizes, SizeSecs* secs)
+{
+  sizes[0] = sizes[1] = sizes[2] = 0;
+  for ( uint32_t i = 0; i < aof->header.num_areas; i ++ )
+  {
+    AofAreaHeader const* a = &aof->areas[i];
+    char const* name = secs ? ChunkFile_getStr(ch, a->name) : NULL;
+    if ( secs && (!name || sizeSecsPush(secs, name, strlen(name), a->size, a->base_addr)) )
+      return 1;
 
-    numPopulatedSec ++;
-    if ( numPopulatedSec == 4 )
-      break;
+    sizeClassify(sizes, a->size, a->attributes & AofAreaAttrib_CODE,
+                 a->attributes & AofAreaAttrib_R_ONLY, a->attributes & AofAreaAttrib_ZEROI);
   }
-
-  printf("%zu\t%zu\t%zu\t%zu\t%s\n",
-      secSizes[0], secSizes[1], secSizes[2], sum, filename);
+  return 0;
 }
 
-static int sizeObjfile(FILE* file, const char * filename)
+/** [secs] NULL unless -A; 0 = ok */
+static int sizeObjfile(FILE* file, Sizes sizes, SizeSecs* secs)
 {
   OpElf elf;
   rewind(file);
   if ( !OpElf_open(&elf, file, NULL) )
   {
-    sizeElf(&elf, filename);
+    int err = sizeElf(&elf, sizes, secs);
     OpElf_close(&elf);
-    return 0;
+    return err;
   }
 
   OpPe pe;
   rewind(file);
   if ( !OpPe_open(&pe, file) )
   {
-    sizePe(&pe, filename);
+    int err = sizePe(&pe, sizes, secs);
     OpPe_close(&pe);
-    return 0;
+    return err;
+  }
+
+  // only the area headers are needed, not the symbols
+  ChunkFile ch;
+  if ( !ChunkFile_open(&ch, file) )
+  {
+    Aof aof;
+    int err = Aof_readHeaders(&aof, &ch) || sizeAof(&aof, &ch, sizes, secs);
+    Aof_free(&aof);
+    ChunkFile_close(&ch);
+    return err;
   }
 
   return 1;
 }
 
-static void sizeAr(SmartArchive* ar)
+typedef enum {
+  SizeStatus_OK,
+  SizeStatus_PENDING /** archive member that still has to be sized from [data] */,
+  SizeStatus_NO_FILE,
+  SizeStatus_NO_MEMBER /** thin archive member that could not be opened */,
+  SizeStatus_UNKNOWN /** not an object file */,
+  SizeStatus_CONTAINER /** archive or library, its members are items of their own */,
+} SizeStatus;
+
+/** one line of output; results are only printed once everything is sized, in input order */
+typedef struct {
+  char const* path;
+  char* member /** heap; NULL unless an archive or library member */;
+  uint8_t const* data /** of PENDING members, in the archive mapping */;
+  size_t size;
+  Sizes sizes;
+  /** only for -A */
+  SizeSecs secs;
+  SizeStatus status;
+} SizeItem;
+
+typedef struct {
+  SizeItem* items;
+  size_t len, cap;
+  /** -A: every item also gets its sections */
+  bool sysv;
+} SizeList;
+
+/** what a worker gets */
+typedef struct {
+  SizeItem* items;
+  bool sysv;
+} SizeJob;
+
+/** NULL if out of memory */
+static SizeItem* sizeMemberItem(SizeList* l, char const* path, char const* name, size_t nameLen,
+                                SizeStatus status, uint8_t const* data, size_t size)
 {
-  SmartArchive_rewind(ar);
+  if ( l->len == l->cap )
+  {
+    size_t cap = l->cap ? l->cap * 2 : 64;
+    SizeItem* n = realloc(l->items, cap * sizeof(SizeItem));
+    if ( !n ) {
+      fprintf(stderr, "out of memory\n");
+      return NULL;
+    }
+    l->items = n;
+    l->cap = cap;
+  }
 
+  SizeItem* it = &l->items[l->len];
+  memset(it, 0, sizeof(SizeItem));
+  it->path = path;
+  it->data = data;
+  it->size = size;
+  it->status = status;
+  if ( name && !(it->member = strndup(name, nameLen)) ) {
+    fprintf(stderr, "out of memory\n");
+    return NULL;
+  }
+  l->len ++;
+  return it;
+}
+
+/** sizes [it] from [file], which is at any position */
+static void sizeItemFrom(SizeItem* it, FILE* file, bool sysv)
+{
+  if ( file && !sizeObjfile(file, it->sizes, sysv ? &it->secs : NULL) )
+    it->status = SizeStatus_OK;
+  else {
+    it->status = SizeStatus_UNKNOWN;
+    sizeSecsFree(&it->secs);
+  }
+}
+
+/** for member data that is only valid until the archive moves on */
+static void sizeMemberNow(SizeItem* it, void const* data, size_t size, bool sysv)
+{
+  FILE* file = size ? memFileOpenReadOnly((void*) data, size) : NULL;
+  sizeItemFrom(it, file, sysv);
+  if ( file )
+    fclose(file);
+}
+
+/**
+ * regular archives only remember where the members are, they are sized on the
+ * worker pool later; thin archive members are mapped one at a time, so they are sized right away
+ */
+static void sizeAr(MappedArchive* ar, SizeList* l, const char * path)
+{
+  MappedArchive_rewind(ar);
+
+  ArMemberView m;
+  while ( MappedArchive_next(ar, &m) )
+  {
+    SizeStatus status = ar->thin ? SizeStatus_NO_MEMBER : SizeStatus_PENDING;
+    SizeItem* it = sizeMemberItem(l, path, m.name, m.nameLen, status, m.data, m.size);
+    if ( it && ar->thin && m.data )
+    {
+      it->data = NULL;
+      sizeMemberNow(it, m.data, m.size, l->sysv);
+    }
+  }
+}
+
+/**
+ * for archives that can not be mapped, e.g. bigger than the address space:
+ * a member is only read into memory once its first bytes look like an object file
+ */
+static void sizeArStream(SmartArchive* ar, SizeList* l, const char * path)
+{
   char* name;
   while ( (name = SmartArchive_nextFileNameHeap(ar)) )
   {
-    void* data; size_t size;
-    if ( SmartArchive_continueWithData(&data, &size, ar) )
+    if ( Ar_isMetaMember(name) )
     {
-      fprintf(stderr, "out of memory\n");
-      return;
+      SmartArchive_continueNoData(ar);
+      free(name);
+      continue;
     }
 
-    FILE* file = memFileOpenReadOnly(data, size);
+    unsigned char magic[4];
+    size_t got = SmartArchive_peekData(ar, magic, sizeof(magic));
 
-    if ( sizeObjfile(file, name) )
-    {
-      fprintf(stderr, "%s: unrecognized format\n", name);
-    }
+    void* data = NULL;
+    size_t size = 0;
+    SizeItem* it = sizeMemberItem(l, path, name, strlen(name), SizeStatus_UNKNOWN, NULL, 0);
+    if ( !it || ObjFmt_detect(magic, got) == ObjFmt_UNKNOWN )
+      SmartArchive_continueNoData(ar);
+    else if ( !SmartArchive_continueWithData(&data, &size, ar) )
+      sizeMemberNow(it, data, size, l->sysv);
 
-    fclose(file);
     free(data);
-
     free(name);
   }
 }
 
-static char supportedFormatsStr[] = "Support file formats: {ELF{32,64},PE,COFF}";
+/** members of ALF libraries are read from the library file where they are */
+static void sizeAlf(Alf* alf, SizeList* l, const char * path)
+{
+  AlfMember m;
+  while ( Alf_next(alf, &m) )
+  {
+    SizeItem* it = sizeMemberItem(l, path, m.name, m.name_len, SizeStatus_UNKNOWN, NULL, 0);
+    if ( !it )
+      continue;
+
+    // only the area headers are needed, not the symbols
+    ChunkFile ch;
+    Aof aof;
+    if ( ChunkFile_openAt(&ch, alf->ch.file, m.file_offset) )
+      continue;
+    if ( !Aof_readHeaders(&aof, &ch) && !sizeAof(&aof, &ch, it->sizes, l->sysv ? &it->secs : NULL) )
+      it->status = SizeStatus_OK;
+    Aof_free(&aof);
+    ChunkFile_close(&ch);
+  }
+}
+
+/** first pass, on the worker pool: plain object files are sized, containers only recognized */
+static void sizeInput(void* ctx, size_t i)
+{
+  SizeJob* job = ctx;
+  SizeItem* it = &job->items[i];
+  FILE* f = fopen(it->path, "rb");
+  if ( !f ) {
+    it->status = SizeStatus_NO_FILE;
+    return;
+  }
+
+  unsigned char magic[8];
+  size_t got = fread(magic, 1, sizeof(magic), f);
+  Alf alf;
+  if ( got == 8 && (!memcmp(magic, "!<arch>\n", 8) || !memcmp(magic, "!<thin>\n", 8)) )
+    it->status = SizeStatus_CONTAINER;
+  else if ( ObjFmt_detect(magic, got) == ObjFmt_AOF && !Alf_open(&alf, f) )
+  {
+    Alf_close(&alf);
+    it->status = SizeStatus_CONTAINER;
+  }
+  else
+    sizeItemFrom(it, f, job->sysv);
+  fclose(f);
+}
+
+/** second pass, on the worker pool: members of mapped archives */
+static void sizePending(void* ctx, size_t i)
+{
+  SizeJob* job = ctx;
+  SizeItem* it = &job->items[i];
+  if ( it->status != SizeStatus_PENDING )
+    return;
+
+  // the member is read straight out of the mapping
+  sizeMemberNow(it, it->data, it->size, job->sysv);
+}
+
+/** archives that are mapped at the same time, at most */
+#define SIZE_MAX_MAPPED 256
+
+static char supportedFormatsStr[] = "Support file formats: {ELF{32,64},PE,COFF,AOF}, ALF";
 
 int main(int argc, char const* const* argv)
 {
+  RecWriter writer;
+  RecWriter* w = NULL;
+  RecFormat format;
+  bool totals = false;
+  bool sysv = false;
+
+  char const** paths = malloc(sizeof(char*) * (argc > 1 ? argc : 1));
+  size_t npaths = 0;
+  bool badArgs = !paths;
+  for ( int i = 1; i < argc && paths; i ++ )
+  {
+    char const* arg = argv[i];
+    if ( !strcmp(arg, "-B") || !strcmp(arg, "--format=berkeley") )
+      w = NULL, sysv = false;
+    else if ( !strcmp(arg, "-A") || !strcmp(arg, "--format=sysv") )
+      w = NULL, sysv = true;
+    else if ( !strncmp(arg, "--format=", 9) && !RecFormat_parse(&format, arg + 9) )
+      w = &writer, sysv = false;
+    else if ( !strcmp(arg, "-t") || !strcmp(arg, "--totals") )
+      totals = true;
+    else if ( arg[0] == '-' )
+      badArgs = true;
+    else
+      paths[npaths ++] = arg;
+  }
 
-  if ( argc != 2 ) {
-    fprintf(stderr, "Usage: %s [file]\n%s\n", argv[0], supportedFormatsStr);
+  // the sections have no record representation, and GNU size has no SysV totals either
+  if ( !npaths || badArgs || (sysv && totals) ) {
+    fprintf(stderr, "Usage: %s [-A|-B] [-t] [--format=berkeley|sysv|json|binary] file...\n%s\n", argv[0], supportedFormatsStr);
+    free(paths);
     return 1;
   }
 
-  FILE* f = fopen(argv[1], "rb");
-  if ( f == NULL ) {
-    fprintf(stderr, "could not open file\n");
+  // every input is opened by a worker; archives and libraries only get expanded afterwards
+  SizeItem* inputs = calloc(npaths, sizeof(SizeItem));
+  if ( !inputs ) {
+    fprintf(stderr, "out of memory\n");
+    free(paths);
     return 1;
   }
+  for ( size_t i = 0; i < npaths; i ++ )
+    inputs[i].path = paths[i];
+  SizeJob job = { inputs, sysv };
+  Parallel_for(npaths, 0, sizeInput, &job);
+
+  // regular archives stay mapped until their members are sized, which happens in batches
+  MappedArchive mapped[SIZE_MAX_MAPPED];
+  size_t nmapped = 0;
+  size_t sized = 0;
+  SizeList list = { NULL, 0, 0, sysv };
+  for ( size_t i = 0; i < npaths; i ++ )
+  {
+    if ( nmapped == SIZE_MAX_MAPPED )
+    {
+      job.items = list.items + sized;
+      Parallel_for(list.len - sized, 0, sizePending, &job);
+      sized = list.len;
+      while ( nmapped )
+        MappedArchive_close(&mapped[-- nmapped]);
+    }
 
-  puts("text\tdata\tbss\ttotal\tfilename\n");
+    SizeItem* in = &inputs[i];
+    FILE* f = in->status == SizeStatus_CONTAINER ? fopen(in->path, "rb") : NULL;
+    if ( !f ) {
+      if ( in->status == SizeStatus_CONTAINER )
+        in->status = SizeStatus_NO_FILE;
+      // takes over the sections
+      SizeItem* it = sizeMemberItem(&list, in->path, NULL, 0, in->status, NULL, 0);
+      if ( it )
+        *it = *in;
+      continue;
+    }
 
-  SmartArchive ar;
-  rewind(f);
-  if ( !SmartArchive_open(&ar, f ) )
-  {
-    sizeAr(&ar);
-    SmartArchive_close(&ar);
+    // the mapping does not need the file
+    MappedArchive* ar = &mapped[nmapped];
+    SmartArchive sar;
+    Alf alf;
+    if ( !MappedArchive_open(ar, f) )
+    {
+      MappedArchive_setPath(ar, in->path);
+      sizeAr(ar, &list, in->path);
+      nmapped ++;
+    }
+    else if ( !SmartArchive_open(&sar, f) )
+    {
+      SmartArchive_setPath(&sar, in->path);
+      sizeArStream(&sar, &list, in->path);
+      SmartArchive_close(&sar);
+    }
+    else if ( !Alf_open(&alf, f) )
+    {
+      sizeAlf(&alf, &list, in->path);
+      Alf_close(&alf);
+    }
+    else
+      sizeMemberItem(&list, in->path, NULL, 0, SizeStatus_UNKNOWN, NULL, 0);
     fclose(f);
-    return 0;
   }
 
-  rewind(f);
-  if ( !sizeObjfile(f, argv[1]) )
+  job.items = list.items + sized;
+  Parallel_for(list.len - sized, 0, sizePending, &job);
+  while ( nmapped )
+    MappedArchive_close(&mapped[-- nmapped]);
+
+  if ( w )
+    RecWriter_begin(w, stdout, format, "size");
+  else if ( !sysv )
+    puts("text\tdata\tbss\ttotal\tfilename\n");
+
+  int code = 0;
+  Sizes sum = {0};
+  for ( size_t i = 0; i < list.len; i ++ )
   {
-    fclose(f);
-    return 0;
+    SizeItem* it = &list.items[i];
+    char const* name = it->member ? it->member : it->path;
+    switch ( it->status )
+    {
+      case SizeStatus_OK:
+        if ( sysv )
+          printSysv(&it->secs, it->path, it->member);
+        else
+          printSizes(it->sizes, w, it->path, it->member);
+        for ( int k = 0; k < 3; k ++ )
+          sum[k] += it->sizes[k];
+        break;
+
+      case SizeStatus_NO_FILE:
+        fprintf(stderr, "%s: could not open file\n", name);
+        code = 1;
+        break;
+
+      case SizeStatus_NO_MEMBER:
+        fprintf(stderr, "%s: could not open member\n", name);
+        break;
+
+      default:
+        if ( it->member )
+          fprintf(stderr, "%s: unrecognized format\n", name);
+        else {
+          fprintf(stderr, "%s: Unsupported file format! %s\n", name, supportedFormatsStr);
+          code = 1;
+        }
+        break;
+    }
+    sizeSecsFree(&it->secs);
+    free(it->member);
   }
 
-  fprintf(stderr, "Unsupported file format! %s\n", supportedFormatsStr);
-  fclose(f);
-  return 1;
+  if ( totals )
+    printSizes(sum, w, "(TOTALS)", NULL);
+
+  if ( w )
+    RecWriter_end(w);
+  free(list.items);
+  free(inputs);
+  free(paths);
+  return code;
 }